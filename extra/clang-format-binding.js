@@ -1,10 +1,3 @@
-let wasm;
-
-export function set_wasm(_wasm) {
-	wasm = _wasm;
-	assert_init = () => {};
-}
-
 const registry =
 	typeof FinalizationRegistry === "undefined"
 		? { register: () => {}, unregister: () => {} }
@@ -12,111 +5,267 @@ const registry =
 				impl.delete();
 			});
 
-export class ClangFormat {
-	constructor() {
-		assert_init();
-		this._impl = new wasm.ClangFormat();
-		registry.register(this, this._impl, this);
-	}
+// Creates the API over one Emscripten module, which `set_wasm` provides. Each
+// entry binds its own, so entries loaded side by side use their own modules.
+export function bind() {
+	let wasm;
 
-	with_style(style) {
-		this._impl.with_style(style);
-		return this;
+	function set_wasm(_wasm) {
+		wasm = _wasm;
+		assert_init = () => {};
 	}
 
-	with_fallback_style(style) {
-		this._impl.with_fallback_style(style);
-		return this;
+	class ClangFormat {
+		constructor() {
+			assert_init();
+			this._impl = new wasm.ClangFormat();
+			registry.register(this, this._impl, this);
+		}
+
+		with_style(style) {
+			this._impl.with_style(style);
+			return this;
+		}
+
+		with_fallback_style(style) {
+			this._impl.with_fallback_style(style);
+			return this;
+		}
+
+		with_config(directory, config) {
+			this._impl.with_config(directory, config);
+			return this;
+		}
+
+		without_config(directory) {
+			this._impl.without_config(directory);
+			return this;
+		}
+
+		with_ignore(directory, patterns) {
+			this._impl.with_ignore(directory, patterns);
+			return this;
+		}
+
+		without_ignore(directory) {
+			this._impl.without_ignore(directory);
+			return this;
+		}
+
+		is_ignored(path) {
+			return this._impl.is_ignored(path);
+		}
+
+		filter_ignored(paths) {
+			const list = new wasm.StringList();
+			try {
+				for (const path of paths) {
+					list.push_back(path);
+				}
+
+				const kept = this._impl.filter_ignored(list);
+				try {
+					return Array.from({ length: kept.size() }, (_, i) => kept.get(i));
+				} finally {
+					kept.delete();
+				}
+			} finally {
+				list.delete();
+			}
+		}
+
+		with_stats(enabled = true) {
+			this._impl.with_stats(enabled);
+			return this;
+		}
+
+		with_chunking(enabled = true) {
+			this._impl.with_chunking(enabled);
+			return this;
+		}
+
+		last_stats() {
+			return this._impl.last_stats();
+		}
+
+		profile_lines(content, filename = "<stdin>", count = 10) {
+			const result = this._impl.profile_lines(content, filename, count);
+			return unwrap(result) ?? "";
+		}
+
+		format(content, filename = "<stdin>") {
+			const result = this._impl.format(content, filename);
+			return unwrap(result) ?? content;
+		}
+
+		format_range(content, offset, length, filename = "<stdin>") {
+			const result = this._impl.format_range(content, filename, offset, length);
+			return unwrap(result) ?? content;
+		}
+
+		format_line(content, from, to, filename = "<stdin>") {
+			const result = this._impl.format_line(content, filename, from, to);
+			return unwrap(result) ?? content;
+		}
+
+		format_changed(old_content, content, filename = "<stdin>") {
+			const result = this._impl.format_changed(old_content, content, filename);
+			return unwrap(result) ?? content;
+		}
+
+		format_batch(files) {
+			const codes = new wasm.StringList();
+			const filenames = new wasm.StringList();
+			try {
+				for (const { content, filename = "<stdin>" } of files) {
+					codes.push_back(content);
+					filenames.push_back(filename);
+				}
+
+				const results = this._impl.format_batch(codes, filenames);
+				try {
+					if (results.size() !== files.length) {
+						unwrap(results.get(0));
+					}
+					return files.map(({ content }, i) => unwrap(results.get(i)) ?? content);
+				} finally {
+					results.delete();
+				}
+			} finally {
+				codes.delete();
+				filenames.delete();
+			}
+		}
+
+		format_embedded(content, kind = "markdown") {
+			const result = this._impl.format_embedded(content, kind);
+			return unwrap(result) ?? content;
+		}
+
+		static heap_stats() {
+			assert_init();
+			return wasm.ClangFormat.heap_stats();
+		}
+
+		static version() {
+			assert_init();
+			return wasm.ClangFormat.version();
+		}
+
+		static dump_config({ style = "file", filename = "<stdin>", code = "" } = {}) {
+			assert_init();
+			const result = wasm.ClangFormat.dump_config(style, filename, code);
+			return unwrap(result);
+		}
+
+		[Symbol.dispose]() {
+			if (this._impl) {
+				registry.unregister(this);
+				this._impl.delete();
+				this._impl = null;
+			}
+		}
 	}
 
-	format(content, filename = "<stdin>") {
-		const result = this._impl.format(content, filename);
-		return unwrap(result) ?? content;
+	function assert_init() {
+		throw new Error("uninit");
 	}
 
-	format_range(content, offset, length, filename = "<stdin>") {
-		const result = this._impl.format_range(content, filename, offset, length);
-		return unwrap(result) ?? content;
+	function unwrap(result) {
+		const { status, content } = result;
+		if (status === wasm.ResultStatus.Error) {
+			throw Error(content);
+		}
+		if (status === wasm.ResultStatus.Unchanged) {
+			return null;
+		}
+		return content;
 	}
 
-	format_line(content, from, to, filename = "<stdin>") {
-		const result = this._impl.format_line(content, filename, from, to);
-		return unwrap(result) ?? content;
+	function version() {
+		return ClangFormat.version();
 	}
 
-	static version() {
-		assert_init();
-		return wasm.ClangFormat.version();
+	function heap_stats() {
+		return ClangFormat.heap_stats();
 	}
 
-	static dump_config({ style = "file", filename = "<stdin>", code = "" } = {}) {
-		assert_init();
-		const result = wasm.ClangFormat.dump_config(style, filename, code);
-		return unwrap(result);
+	function dump_config(args) {
+		return ClangFormat.dump_config(args);
 	}
 
-	[Symbol.dispose]() {
-		if (this._impl) {
-			registry.unregister(this);
-			this._impl.delete();
-			this._impl = null;
+	function format(content, filename = "<stdin>", style = "LLVM") {
+		const formatter = new ClangFormat();
+		try {
+			return formatter.with_style(style).format(content, filename);
+		} finally {
+			formatter[Symbol.dispose]();
 		}
 	}
-}
-
-function assert_init() {
-	throw new Error("uninit");
-}
 
-function unwrap(result) {
-	const { status, content } = result;
-	if (status === wasm.ResultStatus.Error) {
-		throw Error(content);
+	function format_changed(old_content, content, filename = "<stdin>", style = "LLVM") {
+		const formatter = new ClangFormat();
+		try {
+			return formatter.with_style(style).format_changed(old_content, content, filename);
+		} finally {
+			formatter[Symbol.dispose]();
+		}
 	}
-	if (status === wasm.ResultStatus.Unchanged) {
-		return null;
+
+	function format_batch(files, style = "LLVM") {
+		const formatter = new ClangFormat();
+		try {
+			return formatter.with_style(style).format_batch(files);
+		} finally {
+			formatter[Symbol.dispose]();
+		}
 	}
-	return content;
-}
 
-export function version() {
-	return ClangFormat.version();
-}
+	function format_embedded(content, kind = "markdown", style = "LLVM") {
+		const formatter = new ClangFormat();
+		try {
+			return formatter.with_style(style).format_embedded(content, kind);
+		} finally {
+			formatter[Symbol.dispose]();
+		}
+	}
 
-export function dump_config(args) {
-	return ClangFormat.dump_config(args);
-}
+	function format_line_range(content, from, to, filename = "<stdin>", style = "LLVM") {
+		const formatter = new ClangFormat().with_style(style);
+		try {
+			if (from < 1) {
+				throw Error("start line should be at least 1");
+			}
+			if (from > to) {
+				throw Error("start line should not exceed end line");
+			}
 
-export function format(content, filename = "<stdin>", style = "LLVM") {
-	const formatter = new ClangFormat();
-	try {
-		return formatter.with_style(style).format(content, filename);
-	} finally {
-		formatter[Symbol.dispose]();
+			return formatter.format_line(content, from, to, filename);
+		} finally {
+			formatter[Symbol.dispose]();
+		}
 	}
-}
 
-export function format_line_range(content, from, to, filename = "<stdin>", style = "LLVM") {
-	const formatter = new ClangFormat().with_style(style);
-	try {
-		if (from < 1) {
-			throw Error("start line should be at least 1");
+	function format_byte_range(content, offset, length, filename = "<stdin>", style = "LLVM") {
+		const formatter = new ClangFormat().with_style(style);
+		try {
+			return formatter.format_range(content, offset, length, filename);
+		} finally {
+			formatter[Symbol.dispose]();
 		}
-		if (from > to) {
-			throw Error("start line should not exceed end line");
-		}
-
-		return formatter.format_line(content, from, to, filename);
-	} finally {
-		formatter[Symbol.dispose]();
 	}
-}
 
-export function format_byte_range(content, offset, length, filename = "<stdin>", style = "LLVM") {
-	const formatter = new ClangFormat().with_style(style);
-	try {
-		return formatter.format_range(content, offset, length, filename);
-	} finally {
-		formatter[Symbol.dispose]();
-	}
+	return {
+		set_wasm,
+		ClangFormat,
+		dump_config,
+		format,
+		format_batch,
+		format_byte_range,
+		format_changed,
+		format_embedded,
+		format_line_range,
+		heap_stats,
+		version,
+	};
 }
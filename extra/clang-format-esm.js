@@ -2,16 +2,21 @@
 // prettier-ignore
 import source wasmModule from "./clang-format.wasm";
 import { createModule } from "./clang-format.js";
-import { set_wasm } from "./clang-format-binding.js";
+import { bind } from "./clang-format-binding.js";
 
 const wasm = createModule({ wasm: wasmModule });
-set_wasm(wasm);
+const binding = bind();
+binding.set_wasm(wasm);
 
-export {
+export const {
 	ClangFormat,
 	dump_config,
+	format,
+	format_batch,
 	format_byte_range,
+	format_changed,
+	format_embedded,
 	format_line_range,
-	format,
+	heap_stats,
 	version,
-} from "./clang-format-binding.js";
+} = binding;
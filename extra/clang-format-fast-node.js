@@ -0,0 +1,24 @@
+/* @ts-self-types="./clang-format.d.ts" */
+import { readFileSync } from "node:fs";
+import { bind } from "./clang-format-binding.js";
+import { createModule } from "./clang-format-fast.js";
+
+const wasmUrl = new URL("clang-format-fast.wasm", import.meta.url);
+const wasmBytes = readFileSync(wasmUrl);
+
+const wasm = createModule({ wasm: wasmBytes });
+const binding = bind();
+binding.set_wasm(wasm);
+
+export const {
+	ClangFormat,
+	dump_config,
+	format,
+	format_batch,
+	format_byte_range,
+	format_changed,
+	format_embedded,
+	format_line_range,
+	heap_stats,
+	version,
+} = binding;
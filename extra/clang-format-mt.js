@@ -0,0 +1,20 @@
+/* @ts-self-types="./clang-format.d.ts" */
+import createModule from "./clang-format-mt.mjs";
+import { bind } from "./clang-format-binding.js";
+
+const wasm = await createModule();
+const binding = bind();
+binding.set_wasm(wasm);
+
+export const {
+	ClangFormat,
+	dump_config,
+	format,
+	format_batch,
+	format_byte_range,
+	format_changed,
+	format_embedded,
+	format_line_range,
+	heap_stats,
+	version,
+} = binding;
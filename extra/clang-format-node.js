@@ -1,19 +1,24 @@
 /* @ts-self-types="./clang-format.d.ts" */
 import { readFileSync } from "node:fs";
-import { set_wasm } from "./clang-format-binding.js";
+import { bind } from "./clang-format-binding.js";
 import { createModule } from "./clang-format.js";
 
 const wasmUrl = new URL("clang-format.wasm", import.meta.url);
 const wasmBytes = readFileSync(wasmUrl);
 
 const wasm = createModule({ wasm: wasmBytes });
-set_wasm(wasm);
+const binding = bind();
+binding.set_wasm(wasm);
 
-export {
+export const {
 	ClangFormat,
 	dump_config,
 	format,
+	format_batch,
 	format_byte_range,
+	format_changed,
+	format_embedded,
 	format_line_range,
+	heap_stats,
 	version,
-} from "./clang-format-binding.js";
+} = binding;
@@ -1,7 +1,9 @@
 /* @ts-self-types="./clang-format-web.d.ts" */
 let wasm;
 import { createModule } from "./clang-format.js";
-import { set_wasm } from "./clang-format-binding.js";
+import { bind } from "./clang-format-binding.js";
+
+const binding = bind();
 
 async function load(input) {
 	if (typeof Response === "function" && input instanceof Response) {
@@ -71,16 +73,20 @@ export default async function initAsync(init_input) {
 
 function finalize_init(module) {
 	wasm = createModule({ wasm: module });
-	set_wasm(wasm);
+	binding.set_wasm(wasm);
 
 	return wasm;
 }
 
-export {
+export const {
 	ClangFormat,
 	dump_config,
+	format,
+	format_batch,
 	format_byte_range,
+	format_changed,
+	format_embedded,
 	format_line_range,
-	format,
+	heap_stats,
 	version,
-} from "./clang-format-binding.js";
+} = binding;
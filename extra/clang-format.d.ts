@@ -143,6 +143,78 @@ export declare function format_byte_range(
 	style?: Style,
 ): string;
 
+/**
+ * Formats only the lines that changed between two versions of a file using the specified style.
+ *
+ * The changed lines are found with a line diff, like git-clang-format does before passing `-lines`.
+ * Removed lines do not cause any formatting.
+ *
+ * @param {string} old_content - The previous content, e.g. from the last commit.
+ * @param {string} content - The content to format.
+ * @param {Filename} filename - The filename to use for determining the language.
+ * @param {Style} style - The style to use for formatting.
+ *
+ * @returns {string} The content with its changed lines formatted.
+ * @throws {Error}
+ *
+ * @see {@link https://clang.llvm.org/docs/ClangFormatStyleOptions.html}
+ */
+export declare function format_changed(
+	old_content: string,
+	content: string,
+	filename?: Filename,
+	style?: Style,
+): string;
+
+/**
+ * A file to format as part of a batch.
+ */
+export interface BatchFile {
+	/** The content to format. */
+	content: string;
+	/** The filename to use for determining the language. Defaults to "<stdin>". */
+	filename?: Filename;
+}
+
+/**
+ * Formats many files in a single call using the specified style.
+ *
+ * The style is resolved once per language for the whole batch.
+ * With the `./mt` entry point the files are formatted in parallel.
+ *
+ * @param {BatchFile[]} files - The files to format.
+ * @param {Style} style - The style to use for formatting.
+ *
+ * @returns {string[]} The formatted contents, in the order of `files`.
+ * @throws {Error}
+ *
+ * @see {@link https://clang.llvm.org/docs/ClangFormatStyleOptions.html}
+ */
+export declare function format_batch(files: BatchFile[], style?: Style): string[];
+
+/**
+ * The kind of host document for embedded code formatting.
+ */
+export type DocumentKind = "markdown" | (string & {});
+
+/**
+ * Formats the fenced code blocks embedded in the given document using the specified style.
+ *
+ * The language of each block is taken from its info string (```cpp, ```java, ```proto, ...).
+ * Blocks in languages clang-format does not handle are left as they are.
+ * The indentation of each block is preserved.
+ *
+ * @param {string} content - The document containing code blocks.
+ * @param {DocumentKind} kind - The kind of the document. Defaults to "markdown".
+ * @param {Style} style - The style to use for formatting.
+ *
+ * @returns {string} The document with its code blocks formatted.
+ * @throws {Error}
+ *
+ * @see {@link https://clang.llvm.org/docs/ClangFormatStyleOptions.html}
+ */
+export declare function format_embedded(content: string, kind?: DocumentKind, style?: Style): string;
+
 /**
  * Gets the clang-format version.
  *
@@ -151,6 +223,74 @@ export declare function format_byte_range(
  */
 export declare function version(): string;
 
+/**
+ * Heap usage of the WASM module since it was instantiated.
+ *
+ * Totals count allocations made through C++ `new`, which covers nearly all of clang-format.
+ */
+export interface HeapStats {
+	/** The total number of bytes allocated. */
+	allocated_bytes: number;
+	/** The total number of bytes freed. */
+	freed_bytes: number;
+	/** The total number of allocations. */
+	allocations: number;
+	/** The total number of frees. */
+	frees: number;
+	/** The number of bytes currently allocated. */
+	current_bytes: number;
+	/** The highest number of bytes allocated at once. */
+	peak_bytes: number;
+	/** The size of the linear memory in bytes. */
+	memory_bytes: number;
+}
+
+/**
+ * Gets the heap usage of the WASM module.
+ *
+ * @returns The heap stats.
+ * @throws {Error} If the WASM module has not been initialized.
+ */
+export declare function heap_stats(): HeapStats;
+
+/**
+ * Work done by the last formatting call of a {@link ClangFormat} instance.
+ *
+ * Calls that format several files or code blocks report the sum over all of them.
+ */
+export interface FormatStats {
+	/** The number of input bytes. */
+	bytes: number;
+	/** The number of tokens in the code after sorting includes. */
+	tokens: number;
+	/** The number of replacements, including those from sorting includes. */
+	replacements: number;
+	/** The number of replacements from sorting includes. */
+	include_replacements: number;
+	/** The number of styles resolved, 0 when all were cached. */
+	styles_resolved: number;
+	/** Milliseconds spent resolving the style. */
+	style_ms: number;
+	/** Milliseconds spent sorting includes. */
+	sort_includes_ms: number;
+	/** Milliseconds spent in the formatter. */
+	reformat_ms: number;
+	/** Milliseconds spent applying replacements. */
+	apply_ms: number;
+	/** The number of bytes allocated during the call. */
+	heap_allocated_bytes: number;
+	/** The number of allocations during the call. */
+	heap_allocations: number;
+	/** The highest number of bytes the call held allocated at once. */
+	heap_peak_bytes: number;
+	/** The number of passes in which the code was parsed, one per analyzer and combination of preprocessor branches. */
+	parse_passes: number;
+	/** The number of unwrapped lines the parser produced, over all passes. */
+	unwrapped_lines: number;
+	/** The number of states explored by the line breaking search. */
+	penalty_states: number;
+}
+
 /**
  * A class for formatting code using clang-format.
  *
@@ -190,6 +330,104 @@ export declare class ClangFormat {
 	 */
 	with_fallback_style(style: Style): this;
 
+	/**
+	 * Registers the `.clang-format` of a directory.
+	 *
+	 * With the style "file" (the default), each file is formatted with the configs registered for its directory and
+	 * its parents, like the CLI does on disk, including `InheritParentConfig`. Relative paths are relative to the root.
+	 *
+	 * @param directory - The directory the config belongs to, e.g. "src/lib".
+	 * @param config - The content of the `.clang-format` file.
+	 * @returns This instance for method chaining.
+	 */
+	with_config(directory: string, config: string): this;
+
+	/**
+	 * Removes the `.clang-format` registered for a directory.
+	 *
+	 * @param directory - The directory the config belongs to.
+	 * @returns This instance for method chaining.
+	 */
+	without_config(directory: string): this;
+
+	/**
+	 * Registers the `.clang-format-ignore` of a directory.
+	 *
+	 * Files matched by the nearest registered ignore file are returned unchanged by the format methods,
+	 * and can be filtered out up front with {@link ClangFormat.filter_ignored}.
+	 *
+	 * @param directory - The directory the ignore file belongs to, e.g. "src/lib".
+	 * @param patterns - The content of the `.clang-format-ignore` file.
+	 * @returns This instance for method chaining.
+	 */
+	with_ignore(directory: string, patterns: string): this;
+
+	/**
+	 * Removes the `.clang-format-ignore` registered for a directory.
+	 *
+	 * @param directory - The directory the ignore file belongs to.
+	 * @returns This instance for method chaining.
+	 */
+	without_ignore(directory: string): this;
+
+	/**
+	 * Checks whether a path is ignored by the registered ignore files.
+	 *
+	 * @param path - The path to check.
+	 * @returns Whether the path is ignored.
+	 */
+	is_ignored(path: string): boolean;
+
+	/**
+	 * Removes the paths ignored by the registered ignore files.
+	 *
+	 * @param paths - The paths to check.
+	 * @returns The paths that are not ignored, in their original order.
+	 */
+	filter_ignored(paths: string[]): string[];
+
+	/**
+	 * Enables or disables collecting stats for each formatting call.
+	 *
+	 * @param enabled - Whether to collect stats. Defaults to true.
+	 * @returns This instance for method chaining.
+	 */
+	with_stats(enabled?: boolean): this;
+
+	/**
+	 * Enables or disables formatting large files in chunks.
+	 *
+	 * Files of at least 128 KiB that are formatted whole are then split at
+	 * top-level declarations after an empty line and formatted in chunks of at
+	 * least 64 KiB, which bounds the memory formatting takes.
+	 *
+	 * @param enabled - Whether to format in chunks. Defaults to true.
+	 * @returns This instance for method chaining.
+	 */
+	with_chunking(enabled?: boolean): this;
+
+	/**
+	 * Gets the stats of the last formatting call.
+	 *
+	 * All fields are 0 if stats are disabled or nothing was formatted yet.
+	 *
+	 * @returns The stats of the last call.
+	 */
+	last_stats(): FormatStats;
+
+	/**
+	 * Reports the source lines that cost the most to format.
+	 *
+	 * The content is formatted once while the time and the number of states of the line breaking search are recorded for each unwrapped line.
+	 *
+	 * @param content - The content to profile.
+	 * @param filename - The filename to use for determining the language. Defaults to "<stdin>".
+	 * @param count - The number of line ranges to report. Defaults to 10.
+	 * @returns The report, one unwrapped line per line with its milliseconds, states and source lines, most expensive first.
+	 * @throws {Error} If the style cannot be resolved.
+	 */
+	profile_lines(content: string, filename?: Filename, count?: number): string;
+
 	/**
 	 * Formats the given content.
 	 *
@@ -224,6 +462,38 @@ export declare class ClangFormat {
 	 */
 	format_line(content: string, from_line: number, to_line: number, filename?: Filename): string;
 
+	/**
+	 * Formats only the lines that changed since the previous content.
+	 *
+	 * @param old_content - The previous content.
+	 * @param content - The content to format.
+	 * @param filename - The filename to use for determining the language. Defaults to "<stdin>".
+	 * @returns The content with its changed lines formatted.
+	 * @throws {Error} If formatting fails.
+	 */
+	format_changed(old_content: string, content: string, filename?: Filename): string;
+
+	/**
+	 * Formats many files in a single call.
+	 *
+	 * @param files - The files to format.
+	 * @returns The formatted contents, in the order of `files`.
+	 * @throws {Error} If formatting any of the files fails.
+	 */
+	format_batch(files: BatchFile[]): string[];
+
+	/**
+	 * Formats the fenced code blocks embedded in the given document.
+	 *
+	 * All blocks are formatted in a single call, resolving the style once per language.
+	 *
+	 * @param content - The document containing code blocks.
+	 * @param kind - The kind of the document. Defaults to "markdown".
+	 * @returns The document with its code blocks formatted.
+	 * @throws {Error} If formatting fails.
+	 */
+	format_embedded(content: string, kind?: DocumentKind): string;
+
 	/**
 	 * Gets the clang-format version.
 	 *
@@ -232,6 +502,13 @@ export declare class ClangFormat {
 	 */
 	static version(): string;
 
+	/**
+	 * Gets the heap usage of the WASM module.
+	 *
+	 * @returns The heap stats.
+	 */
+	static heap_stats(): HeapStats;
+
 	/**
 	 * Dumps the configuration for the given style.
 	 *
@@ -0,0 +1,44 @@
+#!/usr/bin/env node
+// Measures how alignment passes scale with the length of aligned runs.
+// The time per line should stay flat as the runs grow.
+// Usage: node scripts/bench_alignment.mjs [max_lines] [runs]
+import { performance } from "node:perf_hooks";
+
+import { format } from "../pkg/clang-format-node.js";
+
+const max_lines = Number(process.argv[2] ?? 8192);
+const runs = Number(process.argv[3] ?? 3);
+
+const lines = (count, line) => Array.from({ length: count }, (_, i) => line(i)).join("\n") + "\n";
+
+const inputs = {
+	AlignConsecutiveAssignments: (count) => lines(count, (i) => `int v${i} = ${i};`),
+	AlignConsecutiveDeclarations: (count) => lines(count, (i) => `${"unsigned ".repeat(i % 3)}int v${i};`),
+	AlignConsecutiveMacros: (count) => lines(count, (i) => `#define REGISTER_${i} ${i}`),
+	AlignTrailingComments: (count) => lines(count, (i) => (i % 2 ? `// note ${i}` : `int v${i}; // value ${i}`)),
+};
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["option", "lines", "median (ms)", "per line (us)"].join("\t"));
+
+for (const [option, generate] of Object.entries(inputs)) {
+	const style = JSON.stringify({ BasedOnStyle: "LLVM", [option]: true, ColumnLimit: 0 });
+
+	for (let count = 256; count <= max_lines; count *= 2) {
+		const code = generate(count);
+		const times = [];
+
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			format(code, "bench.h", style);
+			times.push(performance.now() - start);
+		}
+
+		const ms = median(times);
+		console.log([option, count, ms.toFixed(2), ((ms * 1000) / count).toFixed(2)].join("\t"));
+	}
+}
@@ -0,0 +1,35 @@
+#!/usr/bin/env node
+// Measures formatting throughput on the test data corpus.
+// Usage: node scripts/bench_corpus.mjs [runs]
+import { readdirSync, readFileSync } from "node:fs";
+import { join } from "node:path";
+import { performance } from "node:perf_hooks";
+
+import { format } from "../pkg/clang-format-node.js";
+
+const runs = Number(process.argv[2] ?? 10);
+const dirs = ["test_data", "test_data_cli"];
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["file", "bytes", "median (ms)", "MB/s"].join("\t"));
+
+for (const dir of dirs) {
+	for (const name of readdirSync(dir).filter((name) => !name.endsWith(".snap"))) {
+		const code = readFileSync(join(dir, name), "utf-8");
+		const bytes = Buffer.byteLength(code);
+		const times = [];
+
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			format(code, name);
+			times.push(performance.now() - start);
+		}
+
+		const ms = median(times);
+		console.log([join(dir, name), bytes, ms.toFixed(2), (bytes / 1e3 / ms).toFixed(2)].join("\t"));
+	}
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env node
+// Measures formatting latency and heap peak per input byte on large files.
+// With chunking, files of top-level declarations are formatted in chunks, so
+// their heap peak stays flat as they grow; a file wrapped in a namespace is
+// formatted whole.
+// Usage: node scripts/bench_large_files.mjs [max_kib] [runs]
+import { performance } from "node:perf_hooks";
+
+import { ClangFormat } from "../pkg/clang-format-node.js";
+
+const max_kib = Number(process.argv[2] ?? 8192);
+const runs = Number(process.argv[3] ?? 3);
+
+const declaration = (i) =>
+	`struct Node${i}{int key;Node${i} *next;};\nint sum${i}(const Node${i} *n){int s=0;for(;n;n=n->next)s+=n->key*${i};return s;}\n`;
+const declarations = (kib) => {
+	const parts = [];
+	for (let i = 0, bytes = 0; bytes < kib * 1024; i++) {
+		parts.push(declaration(i));
+		bytes += parts.at(-1).length + 1;
+	}
+	return parts.join("\n");
+};
+
+const inputs = {
+	"top level": declarations,
+	namespace: (kib) => `namespace bench {\n\n${declarations(kib)}\n} // namespace bench\n`,
+};
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["input", "chunking", "bytes", "median (ms)", "heap peak (bytes)", "peak per byte"].join("\t"));
+
+for (const [name, generate] of Object.entries(inputs)) {
+	for (const chunking of [false, true]) {
+		const formatter = new ClangFormat().with_stats().with_chunking(chunking);
+
+		for (let kib = 64; kib <= max_kib; kib *= 2) {
+			const code = generate(kib);
+			const times = [];
+			let peak = 0;
+
+			for (let i = 0; i < runs; i++) {
+				const start = performance.now();
+				formatter.format(code, "bench.cc");
+				times.push(performance.now() - start);
+				peak = Math.max(peak, formatter.last_stats().heap_peak_bytes);
+			}
+
+			const row = [name, chunking, code.length, median(times).toFixed(2), peak, (peak / code.length).toFixed(1)];
+			console.log(row.join("\t"));
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#!/usr/bin/env node
+// Measures formatting latency against the item count of a braced list. Lists
+// of literals with more items than the library's threshold are laid out
+// without the line breaking search; tables of structs are not.
+// Usage: node scripts/bench_lists.mjs [max_items] [runs]
+import { performance } from "node:perf_hooks";
+
+import { format } from "../pkg/clang-format-node.js";
+
+const max_items = Number(process.argv[2] ?? 65536);
+const runs = Number(process.argv[3] ?? 5);
+
+const items = (count, item) => Array.from({ length: count }, (_, i) => item(i)).join(", ");
+
+const inputs = {
+	numbers: (count) => `int table[] = {${items(count, (i) => (i * 7919) % 100003)}};\n`,
+	bytes: (count) =>
+		`static const unsigned char data[] = {${items(count, (i) => `0x${(i & 0xff).toString(16).padStart(2, "0")}`)}};\n`,
+	strings: (count) => `const char *names[] = {${items(count, (i) => `"name${i}"`)}};\n`,
+	structs: (count) => `Point points[] = {${items(count, (i) => `{${i}, ${-i}}`)}};\n`,
+};
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["input", "items", "median (ms)", "result"].join("\t"));
+
+for (const [name, generate] of Object.entries(inputs)) {
+	for (let count = 128; count <= max_items; count *= 2) {
+		const code = generate(count);
+		const times = [];
+		let result = "ok";
+
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			try {
+				format(code, "bench.cc");
+			} catch (e) {
+				result = e.message;
+			}
+			times.push(performance.now() - start);
+		}
+
+		console.log([name, count, median(times).toFixed(2), result].join("\t"));
+	}
+}
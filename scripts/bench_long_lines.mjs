@@ -0,0 +1,45 @@
+#!/usr/bin/env node
+// Measures formatting latency and heap peak on lines that need breaking.
+// Usage: node scripts/bench_long_lines.mjs [max_length] [runs]
+import { performance } from "node:perf_hooks";
+
+import { ClangFormat } from "../pkg/clang-format-node.js";
+
+const max_length = Number(process.argv[2] ?? 256);
+const runs = Number(process.argv[3] ?? 5);
+
+const inputs = {
+	chain: (length) => `auto x = builder${".with(argument)".repeat(length)}.build();\n`,
+	arguments: (length) => `void f() { call(${Array.from({ length }, (_, i) => `argument_${i}`).join(", ")}); }\n`,
+	initializer: (length) => `int table[] = {${Array.from({ length }, (_, i) => `f(${i}, ${i})`).join(", ")}};\n`,
+	repeated: (length) =>
+		"DEFINE_REGISTER_FIELD(CONTROL_REGISTER_BASE, CONTROL_FIELD_OFFSET, CONTROL_FIELD_WIDTH, ACCESS_READ_WRITE);\n".repeat(
+			length,
+		),
+};
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+const formatter = new ClangFormat().with_stats();
+
+console.log(["input", "length", "median (ms)", "heap peak (bytes)"].join("\t"));
+
+for (const [name, generate] of Object.entries(inputs)) {
+	for (let length = 8; length <= max_length; length *= 2) {
+		const code = generate(length);
+		const times = [];
+		let peak = 0;
+
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			formatter.format(code, "bench.cc");
+			times.push(performance.now() - start);
+			peak = Math.max(peak, formatter.last_stats().heap_peak_bytes);
+		}
+
+		console.log([name, length, median(times).toFixed(2), peak].join("\t"));
+	}
+}
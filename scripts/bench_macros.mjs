@@ -0,0 +1,47 @@
+#!/usr/bin/env node
+// Measures formatting latency of the macro-heavy test data against the number
+// of `Macros` definitions in the style. Definitions the code does not use are
+// left out before formatting, so a large macro library costs little.
+// Usage: node scripts/bench_macros.mjs [max_unused] [runs]
+import { readFileSync } from "node:fs";
+import { performance } from "node:perf_hooks";
+
+import { ClangFormat } from "../pkg/clang-format-node.js";
+
+const max_unused = Number(process.argv[2] ?? 4096);
+const runs = Number(process.argv[3] ?? 10);
+
+const code = readFileSync("test_data/macros.cc", "utf-8");
+const dsl = [
+	"TABLE_BEGIN(r, t)=r.begin<t>()",
+	"TABLE_END(r, t)=r.end<t>()",
+	"FIELD(r, t, n)=r.field<t>(n)",
+	"PRIMARY_KEY(r, c)=r.key(c)",
+	"FOREIGN_KEY(r, c, t, k)=r.ref<t>(c, k)",
+	"INDEX(r, i, c)=r.index(i, c)",
+	"CHECK_NOT_EMPTY(row, c)=row.require(!row.empty(c))",
+	"CHECK_GE(row, c, v)=row.require(row.get(c) >= v)",
+	"VALIDATOR(r, t, f)=r.validate<t>(f)",
+];
+const library = (count) => Array.from({ length: count }, (_, i) => `LIB_${i}(a, b)=lib::call${i}(a, b)`);
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["macros", "unused", "first (ms)", "median (ms)"].join("\t"));
+
+for (let unused = 0; unused <= max_unused; unused = unused ? unused * 4 : 16) {
+	const macros = [...dsl, ...library(unused)];
+	const formatter = new ClangFormat().with_style(JSON.stringify({ BasedOnStyle: "LLVM", Macros: macros }));
+	const times = [];
+
+	for (let i = 0; i < runs; i++) {
+		const start = performance.now();
+		formatter.format(code, "macros.cc");
+		times.push(performance.now() - start);
+	}
+
+	console.log([macros.length, unused, times[0].toFixed(2), median(times).toFixed(2)].join("\t"));
+}
@@ -0,0 +1,45 @@
+#!/usr/bin/env node
+// Measures formatting latency against nesting depth.
+// Usage: node scripts/bench_nesting.mjs [max_depth] [runs]
+import { performance } from "node:perf_hooks";
+
+import { format } from "../pkg/clang-format-node.js";
+
+const max_depth = Number(process.argv[2] ?? 1024);
+const runs = Number(process.argv[3] ?? 5);
+
+const inputs = {
+	initializer: (depth) => `int table[] = ${"{".repeat(depth)}1${"}".repeat(depth)};\n`,
+	call: (depth) => `int x = ${"f(".repeat(depth)}1${")".repeat(depth)};\n`,
+	block: (depth) => `void f() ${"{ if (x) ".repeat(depth)}{ g(); }${" }".repeat(depth)}\n`,
+	unbraced: (depth) => `void f() {\n${"if (x) ".repeat(depth)}g();\n}\n`,
+	"else if": (depth) => `void f() {\nif (x) g();\n${"else if (x) g();\n".repeat(depth)}}\n`,
+	template: (depth) => `A${"<A".repeat(depth)}${">".repeat(depth)} a;\n`,
+};
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+console.log(["input", "depth", "median (ms)", "result"].join("\t"));
+
+for (const [name, generate] of Object.entries(inputs)) {
+	for (let depth = 8; depth <= max_depth; depth *= 2) {
+		const code = generate(depth);
+		const times = [];
+		let result = "ok";
+
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			try {
+				format(code, "bench.cc");
+			} catch (e) {
+				result = e.message;
+			}
+			times.push(performance.now() - start);
+		}
+
+		console.log([name, depth, median(times).toFixed(2), result].join("\t"));
+	}
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env node
+// Reports the size and formatting throughput of each build variant in pkg/,
+// to weigh speed against download size. Library variants format the test data
+// corpus in-process; CLI variants format it in one invocation, startup
+// included. Each variant runs in its own process, so that one's heap does not
+// weigh on the next. Variants that were not built are skipped.
+// Usage: node scripts/bench_variants.mjs [runs]
+import { spawnSync } from "node:child_process";
+import { existsSync, readdirSync, readFileSync } from "node:fs";
+import { join } from "node:path";
+import { performance } from "node:perf_hooks";
+import { fileURLToPath } from "node:url";
+import { gzipSync } from "node:zlib";
+
+const pkg = fileURLToPath(new URL("../pkg/", import.meta.url));
+const dirs = ["test_data", "test_data_cli"];
+
+const variants = [
+	{ name: "esm", wasm: "clang-format.wasm", entry: "clang-format-node.js" },
+	{ name: "esm-fast", wasm: "clang-format-fast.wasm", entry: "clang-format-fast-node.js" },
+	{ name: "cli", wasm: "clang-format-cli.wasm", cli: "clang-format-cli.cjs" },
+	{ name: "cli-fast", wasm: "clang-format-cli-fast.wasm", cli: "clang-format-cli-fast.cjs" },
+];
+
+function median(values) {
+	const sorted = [...values].sort((a, b) => a - b);
+	return sorted[sorted.length >> 1];
+}
+
+function corpus() {
+	return dirs.flatMap((dir) =>
+		readdirSync(dir)
+			.filter((name) => !name.endsWith(".snap"))
+			.map((name) => join(dir, name)),
+	);
+}
+
+// Formats the corpus with the library entry `entry` and prints the timings.
+async function measureLibrary(entry, runs) {
+	const start = performance.now();
+	const { format } = await import(join(pkg, entry));
+	const startup = performance.now() - start;
+
+	const files = corpus().map((path) => ({ path, code: readFileSync(path, "utf-8") }));
+	const times = [];
+	for (let i = 0; i < runs; i++) {
+		const start = performance.now();
+		for (const { path, code } of files) {
+			format(code, path);
+		}
+		times.push(performance.now() - start);
+	}
+	console.log(JSON.stringify({ startup, ms: median(times) }));
+}
+
+if (process.argv[2] === "--library") {
+	await measureLibrary(process.argv[3], Number(process.argv[4]));
+	process.exit(0);
+}
+
+const runs = Number(process.argv[2] ?? 10);
+const files = corpus();
+const bytes = files.reduce((total, path) => total + readFileSync(path).length, 0);
+
+console.log(["variant", "wasm (bytes)", "gzip (bytes)", "startup (ms)", "median (ms)", "MB/s"].join("\t"));
+
+for (const variant of variants) {
+	const wasm_path = join(pkg, variant.wasm);
+	const script = join(pkg, variant.entry ?? variant.cli);
+	if (!existsSync(wasm_path) || !existsSync(script)) {
+		console.log([variant.name, "not built"].join("\t"));
+		continue;
+	}
+
+	const wasm = readFileSync(wasm_path);
+	let startup = "";
+	let ms;
+	if (variant.entry) {
+		const child = spawnSync(process.execPath, [fileURLToPath(import.meta.url), "--library", variant.entry, runs], {
+			encoding: "utf-8",
+		});
+		if (child.status !== 0) {
+			console.log([variant.name, "failed", child.stderr.trim()].join("\t"));
+			continue;
+		}
+		const result = JSON.parse(child.stdout);
+		startup = result.startup.toFixed(2);
+		ms = result.ms;
+	} else {
+		const times = [];
+		for (let i = 0; i < runs; i++) {
+			const start = performance.now();
+			spawnSync(process.execPath, [script, "--style=LLVM", ...files], { stdio: "ignore" });
+			times.push(performance.now() - start);
+		}
+		ms = median(times);
+	}
+
+	console.log(
+		[variant.name, wasm.length, gzipSync(wasm).length, startup, ms.toFixed(2), (bytes / 1e3 / ms).toFixed(2)].join(
+			"\t",
+		),
+	);
+}
@@ -36,4 +36,44 @@ node ./pkg/clang-format-cli.cjs --style=file:./scripts/.clang-format -i ./pkg/*.
 cp ./build/_deps/llvm_project-src/clang/tools/clang-format/git-clang-format ./pkg/
 cp ./build/_deps/llvm_project-src/clang/tools/clang-format/clang-format-diff.py ./pkg/
 
+if [[ ! -z "${WASM_MT}" ]]; then
+    mkdir -p build-mt
+    cd build-mt
+    emcmake cmake -G Ninja -DCLANG_FORMAT_WASM_THREADS=ON ..
+    ninja clang-format-mt
+    cd $project_root
+
+    cp ./build-mt/clang-format-mt.mjs ./build-mt/clang-format-mt.wasm ./pkg/
+fi
+
+if [[ ! -z "${WASM_FAST}" ]]; then
+    mkdir -p build-fast
+    cd build-fast
+    emcmake cmake -G Ninja -DCLANG_FORMAT_WASM_FAST=ON ..
+    ninja clang-format-esm-fast clang-format-cli-fast
+    cd $project_root
+
+    cp ./build-fast/clang-format-esm-fast.wasm ./pkg/clang-format-fast.wasm
+    node scripts/esm_patch.mjs build-fast/clang-format-esm-fast.js pkg/clang-format-fast.js
+    echo '#!/usr/bin/env node' | cat - ./build-fast/clang-format-cli-fast.js >./pkg/clang-format-cli-fast.cjs
+    cp ./build-fast/clang-format-cli-fast.wasm ./pkg/
+fi
+
+# The multithreaded and fast variants are only built on request; leave their
+# entries, exports and binary out of the package when they were not.
+node -e '
+const fs = require("node:fs");
+const pkg = JSON.parse(fs.readFileSync("pkg/package.json", "utf8"));
+if (!fs.existsSync("pkg/clang-format-mt.wasm")) {
+	fs.rmSync("pkg/clang-format-mt.js");
+	delete pkg.exports["./mt"];
+}
+if (!fs.existsSync("pkg/clang-format-fast.wasm")) {
+	fs.rmSync("pkg/clang-format-fast-node.js");
+	delete pkg.exports["./fast"];
+	delete pkg.bin["clang-format-fast"];
+}
+fs.writeFileSync("pkg/package.json", JSON.stringify(pkg, null, "\t"));
+'
+
 ls -lh ./pkg
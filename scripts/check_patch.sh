@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+# Applies scripts/patch_llvm.cmake to the llvm-project sources pinned in
+# CMakeLists.txt, twice: the first run fails if an anchor is missing or not
+# unique, and the second must leave the sources as the first one did.
+set -Eeo pipefail
+
+cd $(dirname $0)/..
+project_root=$(pwd)
+
+version=$(grep -Po 'set\(LLVM_VERSION "\K[^"]+' CMakeLists.txt)
+hash=$(grep -Po 'URL_HASH SHA256=\K[0-9a-f]+' CMakeLists.txt)
+tarball=llvm-project-$version.src.tar.xz
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+curl -sSfL -o "$work/$tarball" "https://github.com/llvm/llvm-project/releases/download/llvmorg-$version/$tarball"
+echo "$hash  $work/$tarball" | sha256sum -c -
+tar -xJf "$work/$tarball" -C "$work" "llvm-project-$version.src/clang"
+
+cd "$work/llvm-project-$version.src"
+cmake -P "$project_root/scripts/patch_llvm.cmake"
+cp -R clang "$work/patched"
+cmake -P "$project_root/scripts/patch_llvm.cmake"
+diff -r "$work/patched" clang
+
+echo "patch_llvm.cmake applies to llvm-project $version"
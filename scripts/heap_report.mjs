@@ -0,0 +1,25 @@
+#!/usr/bin/env node
+// Reports heap usage per file, to compare builds across LLVM version bumps.
+// Usage: node scripts/heap_report.mjs <file>...
+import { readFileSync } from "node:fs";
+import { basename } from "node:path";
+
+import { ClangFormat, heap_stats, version } from "../pkg/clang-format-node.js";
+
+const files = process.argv.slice(2);
+const formatter = new ClangFormat().with_stats();
+
+console.log(`# ${version()}`);
+console.log(["file", "bytes", "allocations", "allocated", "peak"].join("\t"));
+
+for (const file of files) {
+	formatter.format(readFileSync(file, "utf8"), basename(file));
+	const stats = formatter.last_stats();
+	console.log(
+		[file, stats.bytes, stats.heap_allocations, stats.heap_allocated_bytes, stats.heap_peak_bytes].join("\t"),
+	);
+}
+
+const heap = heap_stats();
+console.log(["total", "", heap.allocations, heap.allocated_bytes, heap.peak_bytes].join("\t"));
+console.log(`# linear memory: ${heap.memory_bytes} bytes`);
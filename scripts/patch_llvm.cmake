@@ -0,0 +1,1173 @@
+# Applies the clang-format-wasm changes to the fetched LLVM sources.
+# Runs as the PATCH_COMMAND of llvm_project, in its source directory.
+#
+# Each change replaces or extends anchors from the upstream sources. A change
+# is written only when each of its anchors is found exactly once; when an LLVM
+# update moves one the patch step fails, so that no change is silently lost.
+
+# Starts a change to `file`, edited in memory until change_end().
+function(change_begin file)
+    file(READ "${file}" content)
+    set(change_file "${file}" PARENT_SCOPE)
+    set(change_content "${content}" PARENT_SCOPE)
+    set(change_missing "" PARENT_SCOPE)
+endfunction()
+
+function(change_replace anchor text)
+    string(FIND "${change_content}" "${text}" applied)
+    if(NOT applied EQUAL -1)
+        return()
+    endif()
+
+    # An anchor must be unique, or the change could land in the wrong place.
+    string(FIND "${change_content}" "${anchor}" position)
+    string(FIND "${change_content}" "${anchor}" last_position REVERSE)
+    if(position EQUAL -1 OR NOT position EQUAL last_position)
+        string(REGEX MATCH "[^\n]+" line "${anchor}")
+        set(change_missing "${line}" PARENT_SCOPE)
+        return()
+    endif()
+
+    string(REPLACE "${anchor}" "${text}" content "${change_content}")
+    set(change_content "${content}" PARENT_SCOPE)
+endfunction()
+
+function(change_insert_after anchor text)
+    change_replace("${anchor}" "${anchor}${text}")
+    set(change_content "${change_content}" PARENT_SCOPE)
+    set(change_missing "${change_missing}" PARENT_SCOPE)
+endfunction()
+
+function(change_end)
+    if(change_missing)
+        message(FATAL_ERROR "${change_file}: anchor \"${change_missing}\" not found once")
+    endif()
+    file(WRITE "${change_file}" "${change_content}")
+endfunction()
+
+# SIMD comment scanning in the lexer. Comments are skipped one byte at a time
+# unless SSE2 or AltiVec is available, and even then only block comments, so
+# a module built with -msimd128 scanned all of them byte by byte. Block
+# comments now look for the next '/' 16 bytes at a time like the SSE2 path,
+# and line comments, on wasm and SSE2 hosts, for the next newline, NUL or
+# non-ASCII byte, after which the byte loops take over. Whitespace is left
+# alone: the formatter walks every whitespace byte again to count newlines
+# and columns, so skipping it faster here would save at most half the work.
+change_begin(clang/lib/Lex/Lexer.cpp)
+change_insert_after(
+[=[
+#include "clang/Lex/Lexer.h"
+]=]
+[=[
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+]=])
+change_replace(
+[=[
+#elif __ALTIVEC__
+]=]
+[=[
+#elif defined(__wasm_simd128__)
+      const v128_t Slashes = wasm_i8x16_splat('/');
+      while (CurPtr + 16 < BufferEnd) {
+        const v128_t Bytes = wasm_v128_load(CurPtr);
+        if (LLVM_UNLIKELY(wasm_i8x16_bitmask(Bytes) != 0))
+          goto MultiByteUTF8;
+        unsigned Mask = wasm_i8x16_bitmask(wasm_i8x16_eq(Bytes, Slashes));
+        if (Mask != 0) {
+          CurPtr += llvm::countr_zero<unsigned>(Mask) + 1;
+          goto FoundSlash;
+        }
+        CurPtr += 16;
+      }
+#elif __ALTIVEC__
+]=])
+change_insert_after(
+[=[
+    // Skip over characters in the fast loop.
+]=]
+[=[
+#if defined(__wasm_simd128__) || defined(__SSE2__)
+    while (CurPtr + 16 <= BufferEnd) {
+#ifdef __wasm_simd128__
+      const v128_t Bytes = wasm_v128_load(CurPtr);
+      const v128_t Stops = wasm_v128_or(
+          wasm_v128_or(wasm_i8x16_eq(Bytes, wasm_i8x16_splat('\n')),
+                       wasm_i8x16_eq(Bytes, wasm_i8x16_splat('\r'))),
+          wasm_i8x16_eq(Bytes, wasm_i8x16_splat(0)));
+      unsigned Mask =
+          wasm_i8x16_bitmask(Bytes) | wasm_i8x16_bitmask(Stops);
+#else
+      const __m128i Bytes = _mm_loadu_si128((const __m128i *)CurPtr);
+      const __m128i Stops = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('\n')),
+                       _mm_cmpeq_epi8(Bytes, _mm_set1_epi8('\r'))),
+          _mm_cmpeq_epi8(Bytes, _mm_setzero_si128()));
+      unsigned Mask = _mm_movemask_epi8(Bytes) | _mm_movemask_epi8(Stops);
+#endif
+      if (Mask != 0) {
+        CurPtr += llvm::countr_zero(Mask);
+        break;
+      }
+      CurPtr += 16;
+    }
+    C = *CurPtr;
+#endif
+]=])
+change_end()
+
+# ASCII fast path for column widths. Every token's width goes through
+# columnWidthUTF8(), which decodes and looks up each character. Pure ASCII
+# text is as wide as it is long; when columnWidthUTF8() rejects a control
+# character the size is used as well, so the result is the same.
+change_begin(clang/lib/Format/Encoding.h)
+change_insert_after(
+[=[
+inline unsigned columnWidth(StringRef Text, Encoding Encoding) {
+]=]
+[=[
+  unsigned char Bits = 0;
+  for (char C : Text)
+    Bits |= static_cast<unsigned char>(C);
+  if (Bits < 0x80)
+    return Text.size();
+]=])
+change_end()
+
+# Comment split widths without decoding. To find where a comment line must be
+# split, getCommentSplit() measures its text one character at a time, asking
+# for the column width of each and rescanning the text it passed for tabs;
+# this runs for every comment line whenever a state reaches it. ASCII other
+# than tabs is one column per byte, so that prefix is now counted directly
+# and only the rest goes through the per-character loop.
+change_begin(clang/lib/Format/BreakableToken.cpp)
+change_replace(
+[=[
+  for (unsigned NumChars = 0;
+       NumChars < MaxSplit && MaxSplitBytes < Text.size();) {
+]=]
+[=[
+  unsigned NumChars = 0;
+  while (NumChars < MaxSplit && MaxSplitBytes < Text.size() &&
+         static_cast<unsigned char>(Text[MaxSplitBytes]) < 0x80 &&
+         Text[MaxSplitBytes] != '\t') {
+    ++NumChars;
+    ++MaxSplitBytes;
+  }
+  while (NumChars < MaxSplit && MaxSplitBytes < Text.size()) {
+]=])
+change_end()
+
+# Reusable storage for the states of the optimizing line formatter. Each line
+# that needs breaking used to get a fresh allocator whose slabs were freed
+# afterwards, and a fresh priority queue grown from empty. States now come
+# from chunks kept per thread for the next line and call, and queue storage
+# from a per-thread free list. Children are formatted while a line is
+# explored, so formatters nest and each one destroys exactly the states it
+# allocated, newest first. When the outermost formatter is done, chunks and
+# queue storage beyond a small reserve are freed, so one huge line does not
+# keep its memory for the rest of the module's life. Allocated states are
+# counted by penaltyStateCount(), see the work counters below.
+change_begin(clang/lib/Format/UnwrappedLineFormatter.cpp)
+change_replace(
+[=[
+  llvm::SpecificBumpPtrAllocator<StateNode> Allocator;
+]=]
+[=[
+  class StatePool {
+  public:
+    struct Mark {
+      size_t Chunk;
+      size_t Used;
+    };
+
+    Mark mark() const { return {Chunk, Used}; }
+
+    StateNode *allocate() {
+      if (Used == ChunkSize) {
+        ++Chunk;
+        Used = 0;
+      }
+      if (Chunk == Chunks.size())
+        Chunks.push_back(std::make_unique<Slot[]>(ChunkSize));
+      return reinterpret_cast<StateNode *>(&Chunks[Chunk][Used++]);
+    }
+
+    void rewind(Mark M) {
+      while (Chunk != M.Chunk || Used != M.Used) {
+        if (Used == 0) {
+          --Chunk;
+          Used = ChunkSize;
+          continue;
+        }
+        reinterpret_cast<StateNode *>(&Chunks[Chunk][--Used])->~StateNode();
+      }
+      if (Chunk == 0 && Used == 0 && Chunks.size() > KeptChunks)
+        Chunks.resize(KeptChunks);
+    }
+
+  private:
+    static constexpr size_t ChunkSize = 1024;
+    static constexpr size_t KeptChunks = 4;
+    using Slot = std::aligned_storage_t<sizeof(StateNode), alignof(StateNode)>;
+
+    std::vector<std::unique_ptr<Slot[]>> Chunks;
+    size_t Chunk = 0;
+    size_t Used = 0;
+  };
+
+  class NodeAllocator {
+  public:
+    NodeAllocator() : Start(pool().mark()) {}
+    ~NodeAllocator() { pool().rewind(Start); }
+
+    StateNode *Allocate() {
+      ++penaltyStateCount();
+      return pool().allocate();
+    }
+
+  private:
+    static StatePool &pool() {
+      static thread_local StatePool Pool;
+      return Pool;
+    }
+
+    StatePool::Mark Start;
+  };
+
+  // A queue whose storage is taken from and given back to a per-thread free
+  // list. Nested searches each take their own.
+  class PooledQueue : public QueueType {
+  public:
+    PooledQueue() {
+      Pool &P = pool();
+      ++P.Depth;
+      if (!P.Free.empty()) {
+        c = std::move(P.Free.back());
+        P.Free.pop_back();
+      }
+    }
+
+    ~PooledQueue() {
+      Pool &P = pool();
+      c.clear();
+      P.Free.push_back(std::move(c));
+      if (--P.Depth > 0)
+        return;
+      llvm::erase_if(P.Free, [](const container_type &Storage) {
+        return Storage.capacity() > KeptItems;
+      });
+      if (P.Free.size() > KeptQueues)
+        P.Free.resize(KeptQueues);
+    }
+
+  private:
+    static constexpr size_t KeptItems = 64 * 1024;
+    static constexpr size_t KeptQueues = 4;
+
+    struct Pool {
+      std::vector<container_type> Free;
+      unsigned Depth = 0;
+    };
+
+    static Pool &pool() {
+      static thread_local Pool P;
+      return P;
+    }
+  };
+
+  NodeAllocator Allocator;
+]=])
+change_replace(
+[=[
+    QueueType Queue;
+]=]
+[=[
+    PooledQueue Queue;
+]=])
+change_end()
+
+# Memo of the line breaks chosen for lines that need the optimizing formatter.
+# Generated code repeats lines whose tokens, annotations and start column are
+# the same, and so is the result of their search. The memo lives for one
+# formatter run, sharing its style and derived settings through the same
+# ContinuationIndenter; children formatted within the run share it, while raw
+# strings formatted with another style get their own.
+change_begin(clang/lib/Format/UnwrappedLineFormatter.cpp)
+change_insert_after(
+[=[
+#define DEBUG_TYPE "format-formatter"
+]=]
+[=[
+
+#include "llvm/ADT/StringMap.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace format {
+namespace {
+
+class LineMemo {
+public:
+  struct Entry {
+    unsigned Penalty = 0;
+    bool HasPath = false;
+    std::vector<bool> Path;
+  };
+
+  explicit LineMemo(const ContinuationIndenter *Indenter)
+      : Indenter(Indenter) {}
+
+  static LineMemo *current(const ContinuationIndenter *Indenter) {
+    return Current && Current->Indenter == Indenter ? Current : nullptr;
+  }
+
+  // Returns the key of `Line` started at the given columns, or an empty
+  // string if formatting it may depend on more than its own tokens.
+  static std::string key(const AnnotatedLine &Line, unsigned FirstIndent,
+                         unsigned FirstStartColumn) {
+    std::string Key;
+    auto Add = [&](unsigned Value) {
+      Key.append(reinterpret_cast<const char *>(&Value), sizeof(Value));
+    };
+
+    Add(FirstIndent);
+    Add(FirstStartColumn);
+    Add(Line.Level);
+    Add(Line.Type);
+    Add(Line.InPPDirective);
+    Add(Line.MustBeDeclaration);
+    Add(Line.MightBeFunctionDecl);
+    Add(Line.IsMultiVariableDeclStmt);
+    Add(Line.Affected);
+    Add(Line.ReturnTypeWrapped);
+
+    for (const FormatToken *Tok = Line.First; Tok; Tok = Tok->Next) {
+      if (!Tok->Children.empty() || Tok->is(tok::comment) || Tok->MacroCtx ||
+          Tok->IsMultiline)
+        return "";
+      Add(Tok->TokenText.size());
+      Key += Tok->TokenText;
+      Add(Tok->Tok.getKind());
+      Add(Tok->getType());
+      Add(Tok->getBlockKind());
+      Add(Tok->getPackingKind());
+      Add(Tok->getDecision());
+      Add(Tok->NewlinesBefore);
+      Add(Tok->OriginalColumn);
+      Add(Tok->ColumnWidth);
+      Add(Tok->SpacesRequiredBefore);
+      Add(Tok->CanBreakBefore);
+      Add(Tok->MustBreakBefore);
+      Add(Tok->Finalized);
+      Add(Tok->SplitPenalty);
+      Add(Tok->TotalLength);
+      Add(Tok->UnbreakableTailLength);
+      Add(Tok->BindingStrength);
+      Add(Tok->NestingLevel);
+      Add(Tok->IndentLevel);
+      Add(Tok->ParameterCount);
+      Add(Tok->OperatorIndex);
+      Add(Tok->StartsBinaryExpression);
+      Add(Tok->EndsBinaryExpression);
+      Add(Tok->PartOfMultiVariableDeclStmt);
+      Add(Tok->FakeRParens);
+      Add(Tok->FakeLParens.size());
+      for (prec::Level Precedence : Tok->FakeLParens)
+        Add(Precedence);
+    }
+    return Key;
+  }
+
+  Entry &operator[](StringRef Key) { return Entries[Key]; }
+  Entry *find(StringRef Key) {
+    auto It = Entries.find(Key);
+    return It == Entries.end() ? nullptr : &It->second;
+  }
+
+private:
+  friend class LineMemoScope;
+
+  static thread_local LineMemo *Current;
+
+  const ContinuationIndenter *Indenter;
+  llvm::StringMap<Entry> Entries;
+};
+
+thread_local LineMemo *LineMemo::Current = nullptr;
+
+// Makes a memo current for the run using `Indenter` unless one is.
+class LineMemoScope {
+public:
+  explicit LineMemoScope(const ContinuationIndenter *Indenter)
+      : Outer(LineMemo::Current) {
+    if (!Outer || Outer->Indenter != Indenter)
+      LineMemo::Current = &Own.emplace(Indenter);
+  }
+  ~LineMemoScope() { LineMemo::Current = Outer; }
+
+private:
+  LineMemo *Outer;
+  std::optional<LineMemo> Own;
+};
+
+} // namespace
+} // namespace format
+} // namespace clang
+]=])
+change_replace(
+[=[
+    return analyzeSolutionSpace(State, DryRun);
+]=]
+[=[
+    LineMemo *Memo = LineMemo::current(Indenter);
+    std::string Key =
+        Memo ? LineMemo::key(Line, FirstIndent, FirstStartColumn) : "";
+    if (Key.empty())
+      return analyzeSolutionSpace(State, DryRun);
+
+    if (LineMemo::Entry *Entry = Memo->find(Key)) {
+      if (DryRun)
+        return Entry->Penalty;
+      if (Entry->HasPath) {
+        for (bool NewLine : Entry->Path) {
+          unsigned Penalty = 0;
+          formatChildren(State, NewLine, /*DryRun=*/false, Penalty);
+          Indenter->addTokenToState(State, NewLine, /*DryRun=*/false);
+        }
+        return Entry->Penalty;
+      }
+    }
+
+    std::vector<bool> Path;
+    RecordedPath = DryRun ? nullptr : &Path;
+    PathRecorded = false;
+    unsigned Penalty = analyzeSolutionSpace(State, DryRun);
+    RecordedPath = nullptr;
+
+    LineMemo::Entry &Entry = (*Memo)[Key];
+    Entry.Penalty = Penalty;
+    if (PathRecorded) {
+      Entry.HasPath = true;
+      Entry.Path = std::move(Path);
+    }
+    return Penalty;
+]=])
+change_insert_after(
+[=[
+  void reconstructPath(LineState &State, StateNode *Best) {
+]=]
+[=[
+    if (RecordedPath) {
+      for (StateNode *Node = Best; Node->Previous; Node = Node->Previous)
+        RecordedPath->push_back(Node->NewLine);
+      std::reverse(RecordedPath->begin(), RecordedPath->end());
+      PathRecorded = true;
+    }
+]=])
+change_insert_after(
+[=[
+  NodeAllocator Allocator;
+]=]
+[=[
+
+  // Where reconstructPath() records the line breaks it applies, for the memo.
+  std::vector<bool> *RecordedPath = nullptr;
+  bool PathRecorded = false;
+]=])
+change_insert_after(
+[=[
+  LineJoiner Joiner(Style, Keywords, Lines);
+]=]
+[=[
+  LineMemoScope Memo(Indenter);
+]=])
+change_end()
+
+# Linear trailing comment alignment. For a comment on its own line the pass
+# looks for the next change that is not a comment, to see whether the comment
+# was aligned with it; on a long run of comment lines that rescanned the rest
+# of the run for every line. The next non-comment change is now computed once
+# for all changes, in a single backward sweep, when comments are aligned.
+change_begin(clang/lib/Format/WhitespaceManager.cpp)
+change_insert_after(
+[=[
+void WhitespaceManager::alignTrailingComments() {
+  if (Style.AlignTrailingComments.Kind == FormatStyle::TCAS_Never)
+    return;
+]=]
+[=[
+
+  SmallVector<unsigned> NextNonComment(Changes.size() + 1);
+  NextNonComment[Changes.size()] = Changes.size();
+  for (unsigned I = Changes.size(); I-- > 0;) {
+    NextNonComment[I] =
+        Changes[I].Tok->is(tok::comment) ? NextNonComment[I + 1] : I;
+  }
+]=])
+change_replace(
+[=[
+      for (int J = I + 1; J < Size; ++J) {
+        if (Changes[J].Tok->is(tok::comment))
+          continue;
+]=]
+[=[
+      for (int J = NextNonComment[I + 1]; J < Size; ++J) {
+        if (Changes[J].Tok->is(tok::comment))
+          continue;
+]=])
+change_end()
+
+# Environment reuse between reformat passes. After each pass reformat()
+# copied the code and built a new Environment, even when the pass changed
+# nothing, so each enabled fixer that had nothing to fix still paid for a
+# source manager over the whole file. The environment is now only rebuilt
+# after a pass that produced replacements.
+change_begin(clang/lib/Format/Format.cpp)
+change_replace(
+[=[
+      if (I + 1 < E) {
+        CurrentCode = std::move(*NewCode);
+]=]
+[=[
+      if (I + 1 < E && !PassFixes.first.empty()) {
+        CurrentCode = std::move(*NewCode);
+]=])
+change_end()
+
+# Linear preprocessor branch passes. The parser parses the whole file once per
+# combination of branch indices, one index per nesting level of conditionals,
+# enumerating all of them: nested conditionals multiply the passes. Only the
+# combinations that first reach some branch of some conditional are parsed
+# now, in the same order, so every line is formatted in the same pass as
+# before and the passes grow with the number of branches. The branches are
+# counted from the tokens and checked against the parser's own count after
+# every pass; once they differ, the parser enumerates the remaining
+# combinations as before.
+change_begin(clang/lib/Format/UnwrappedLineParser.cpp)
+change_replace(
+[=[
+void UnwrappedLineParser::parse() {
+]=]
+[=[
+// Returns the branch indices per nesting level to parse the conditionals of
+// `Tokens` with, and in `LevelCounts` the number of branches per level as
+// parse() counts them. Branches after '#if 0' are not reached.
+static std::vector<SmallVector<int, 8>>
+getPPBranchPasses(ArrayRef<FormatToken *> Tokens,
+                  SmallVectorImpl<int> &LevelCounts) {
+  SmallVector<int, 8> Path;
+  std::vector<SmallVector<int, 8>> Passes = {{}};
+  for (size_t I = 0; I + 1 < Tokens.size(); ++I) {
+    const FormatToken *Hash = Tokens[I];
+    const FormatToken *Name = Tokens[I + 1];
+    if (Hash->isNot(tok::hash) ||
+        !((Hash->NewlinesBefore > 0 && Hash->HasUnescapedNewline) ||
+          Hash->IsFirst) ||
+        Name->NewlinesBefore > 0 || !Name->Tok.getIdentifierInfo()) {
+      continue;
+    }
+    const FormatToken *Arg =
+        I + 2 < Tokens.size() && Tokens[I + 2]->NewlinesBefore == 0
+            ? Tokens[I + 2]
+            : nullptr;
+    const auto Kind = Name->Tok.getIdentifierInfo()->getPPKeywordID();
+    switch (Kind) {
+    case tok::pp_if:
+    case tok::pp_ifdef:
+    case tok::pp_ifndef: {
+      const bool Unreachable =
+          Arg && ((Kind == tok::pp_if &&
+                   (Arg->is(tok::kw_false) || Arg->TokenText == "0")) ||
+                  (Kind == tok::pp_ifdef && Arg->TokenText == "SWIG"));
+      Path.push_back(Unreachable ? -1 : 0);
+      if (LevelCounts.size() < Path.size())
+        LevelCounts.push_back(0);
+      break;
+    }
+    case tok::pp_elif:
+    case tok::pp_elifdef:
+    case tok::pp_elifndef:
+    case tok::pp_else:
+      if (Path.empty())
+        continue;
+      ++Path.back();
+      break;
+    case tok::pp_endif:
+      if (!Path.empty()) {
+        int &Count = LevelCounts[Path.size() - 1];
+        Count = std::max(Count, Path.back() + 1);
+        Path.pop_back();
+      }
+      continue;
+    default:
+      continue;
+    }
+    if (!llvm::is_contained(Path, -1))
+      Passes.push_back(Path);
+  }
+
+  // Deeper levels take their first branch, as when parse() enumerates them.
+  for (SmallVector<int, 8> &Pass : Passes)
+    Pass.resize(LevelCounts.size(), 0);
+  llvm::sort(Passes);
+  Passes.erase(std::unique(Passes.begin(), Passes.end()), Passes.end());
+  return Passes;
+}
+
+void UnwrappedLineParser::parse() {
+]=])
+change_insert_after(
+[=[
+  IndexedTokenSource TokenSource(AllTokens);
+]=]
+[=[
+  SmallVector<int, 8> LevelCounts;
+  const std::vector<SmallVector<int, 8>> Passes =
+      getPPBranchPasses(AllTokens, LevelCounts);
+  // The first pass takes the first branches, the next ones are chosen after
+  // the pass before them.
+  size_t NextPass = 1;
+  bool EnumerateBranches = false;
+]=])
+change_replace(
+[=[
+    while (!PPLevelBranchIndex.empty() &&
+           PPLevelBranchIndex.back() + 1 >= PPLevelBranchCount.back()) {
+]=]
+[=[
+    // The parser raises the counts it was given to the branches it saw, and
+    // adds levels for deeper conditionals.
+    if (!EnumerateBranches) {
+      EnumerateBranches = PPLevelBranchIndex.size() != LevelCounts.size() ||
+                          !llvm::equal(PPLevelBranchCount, LevelCounts);
+    }
+    if (!EnumerateBranches) {
+      if (NextPass < Passes.size()) {
+        PPLevelBranchIndex.assign(Passes[NextPass].begin(),
+                                  Passes[NextPass].end());
+        PPLevelBranchCount.assign(LevelCounts.begin(), LevelCounts.end());
+        ++NextPass;
+      } else {
+        PPLevelBranchIndex.clear();
+      }
+      continue;
+    }
+    while (!PPLevelBranchIndex.empty() &&
+           PPLevelBranchIndex.back() + 1 >= PPLevelBranchCount.back()) {
+]=])
+change_end()
+
+# Work counters read by the library for its stats, and the line cost callback
+# of its profiler, see src/Counters.h. They are thread_local so that each
+# thread of the multithreaded build counts its own calls. The line cost of a
+# search is its time and states less those of the lines searched within it;
+# searches in another source manager, such as a raw string's, are part of
+# the line containing them.
+change_begin(clang/lib/Format/UnwrappedLineParser.cpp)
+change_insert_after(
+[=[
+void UnwrappedLineParser::addUnwrappedLine(LineLevel AdjustLevel) {
+  if (Line->Tokens.empty())
+    return;
+]=]
+[=[
+  ++unwrappedLineCount();
+]=])
+change_insert_after(
+[=[
+    Callback.finishRun();
+    Lines.clear();
+]=]
+[=[
+    ++parsePassCount();
+]=])
+change_replace(
+[=[
+// Returns the branch indices per nesting level to parse the conditionals of
+]=]
+[=[
+unsigned long long &parsePassCount() {
+  static thread_local unsigned long long Count = 0;
+  return Count;
+}
+
+unsigned long long &unwrappedLineCount() {
+  static thread_local unsigned long long Count = 0;
+  return Count;
+}
+
+// Returns the branch indices per nesting level to parse the conditionals of
+]=])
+change_end()
+
+change_begin(clang/lib/Format/UnwrappedLineFormatter.cpp)
+change_insert_after(
+[=[
+#include <queue>
+]=]
+[=[
+#include <chrono>
+
+namespace clang {
+namespace format {
+
+unsigned long long &penaltyStateCount() {
+  static thread_local unsigned long long Count = 0;
+  return Count;
+}
+
+using LineCostCallback = void (*)(void *Context, unsigned FromLine,
+                                  unsigned ToLine, double Milliseconds,
+                                  unsigned long long States);
+
+namespace {
+
+thread_local LineCostCallback CostCallback = nullptr;
+thread_local void *CostContext = nullptr;
+
+class LineCostScope {
+public:
+  LineCostScope(const ContinuationIndenter *Indenter,
+                const AnnotatedLine &Line)
+      : Outer(Current) {
+    const SourceManager &SourceMgr = Indenter->getSourceManager();
+    if (!CostCallback || (Outer && Outer->SourceMgr != &SourceMgr))
+      return;
+    this->SourceMgr = &SourceMgr;
+    FromLine = SourceMgr.getSpellingLineNumber(Line.First->Tok.getLocation());
+    ToLine = SourceMgr.getSpellingLineNumber(Line.Last->Tok.getLocation());
+    States = penaltyStateCount();
+    Start = std::chrono::steady_clock::now();
+    Current = this;
+  }
+
+  ~LineCostScope() {
+    if (Current != this)
+      return;
+    Current = Outer;
+    const double Milliseconds =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - Start)
+            .count();
+    const unsigned long long Explored = penaltyStateCount() - States;
+    if (Outer) {
+      Outer->NestedMilliseconds += Milliseconds;
+      Outer->NestedStates += Explored;
+    }
+    CostCallback(CostContext, FromLine, ToLine,
+                 Milliseconds - NestedMilliseconds, Explored - NestedStates);
+  }
+
+private:
+  static thread_local LineCostScope *Current;
+
+  LineCostScope *Outer;
+  const SourceManager *SourceMgr = nullptr;
+  unsigned FromLine = 0;
+  unsigned ToLine = 0;
+  unsigned long long States = 0;
+  unsigned long long NestedStates = 0;
+  double NestedMilliseconds = 0;
+  std::chrono::steady_clock::time_point Start;
+};
+
+thread_local LineCostScope *LineCostScope::Current = nullptr;
+
+} // namespace
+
+void setLineCostCallback(LineCostCallback Callback, void *Context) {
+  CostCallback = Callback;
+  CostContext = Context;
+}
+
+} // namespace format
+} // namespace clang
+]=])
+change_insert_after(
+[=[
+    if (State.Line->Type == LT_ObjCMethodDecl)
+      State.Stack.back().BreakBeforeParameter = true;
+]=]
+[=[
+
+    LineCostScope Cost(Indenter, Line);
+]=])
+change_end()
+
+change_begin(clang/lib/Format/ContinuationIndenter.h)
+change_insert_after(
+[=[
+  unsigned getColumnLimit(const LineState &State) const;
+]=]
+[=[
+
+  const SourceManager &getSourceManager() const { return SourceMgr; }
+]=])
+change_end()
+
+# Predefined styles of raw strings resolved once. Every ContinuationIndenter
+# builds the styles of the configured raw string formats, and the predefined
+# styles such as Google's configure several, so each formatter run resolved
+# them again. They only depend on the style name and language and are now kept
+# once for all threads.
+change_begin(clang/lib/Format/ContinuationIndenter.cpp)
+change_insert_after(
+[=[
+#include "ContinuationIndenter.h"
+]=]
+[=[
+#include <mutex>
+]=])
+change_replace(
+[=[
+RawStringFormatStyleManager::RawStringFormatStyleManager(
+]=]
+[=[
+// Returns the style `Name` for `Language` like getPredefinedStyle(), resolving
+// each one once.
+static bool getCachedPredefinedStyle(StringRef Name,
+                                     FormatStyle::LanguageKind Language,
+                                     FormatStyle *Style) {
+  static std::mutex Mutex;
+  static llvm::StringMap<std::optional<FormatStyle>> Styles;
+  std::string Key = (Twine(static_cast<int>(Language)) + ":" + Name).str();
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto [It, Inserted] = Styles.try_emplace(Key);
+  if (Inserted) {
+    FormatStyle Predefined;
+    if (getPredefinedStyle(Name, Language, &Predefined))
+      It->second = std::move(Predefined);
+  }
+  if (!It->second)
+    return false;
+  *Style = *It->second;
+  return true;
+}
+
+RawStringFormatStyleManager::RawStringFormatStyleManager(
+]=])
+change_replace(
+[=[
+      if (!getPredefinedStyle(RawStringFormat.BasedOnStyle,
+]=]
+[=[
+      if (!getCachedPredefinedStyle(RawStringFormat.BasedOnStyle,
+]=])
+change_end()
+
+# Memo of formatted raw strings. A raw string in another language is formatted
+# by a nested reformat() with its own environment whenever the line formatter
+# explores a state that reaches it, and files often repeat the same raw string.
+# The result only depends on the style, the text and its columns, so it is
+# kept once for all threads and reused across states, literals and calls, up
+# to a few megabytes of keys and replacement text after which it starts over.
+change_begin(clang/lib/Format/ContinuationIndenter.cpp)
+change_replace(
+[=[
+unsigned ContinuationIndenter::reformatRawStringLiteral(
+]=]
+[=[
+// Formats `Code` like internal::reformat(), reusing the result of an earlier
+// call with the same arguments.
+static std::pair<tooling::Replacements, unsigned>
+reformatRawText(const FormatStyle &Style, StringRef Code,
+                ArrayRef<tooling::Range> Ranges, unsigned FirstStartColumn,
+                unsigned NextStartColumn, unsigned LastStartColumn,
+                StringRef FileName, FormattingAttemptStatus *Status) {
+  struct StyleMemo {
+    FormatStyle Style;
+    llvm::StringMap<std::pair<tooling::Replacements, unsigned>> Results;
+  };
+  // Raw strings nest, so the lock is not held while one of them is formatted
+  // and the memo may change meanwhile.
+  static std::mutex Mutex;
+  static std::vector<StyleMemo> Memos;
+  static size_t MemoBytes = 0;
+  constexpr size_t MaxStyles = 16;
+  constexpr size_t MaxBytes = 4 << 20;
+
+  if (Status || Ranges.size() != 1 || Ranges[0].getOffset() != 0 ||
+      Ranges[0].getLength() != Code.size()) {
+    return internal::reformat(Style, Code, Ranges, FirstStartColumn,
+                              NextStartColumn, LastStartColumn, FileName,
+                              Status);
+  }
+
+  auto FindMemo = [&] {
+    return llvm::find_if(
+        Memos, [&](const StyleMemo &Memo) { return Memo.Style == Style; });
+  };
+  std::string Key = (Twine(FirstStartColumn) + " " + Twine(NextStartColumn) +
+                     " " + Twine(LastStartColumn) + " " + FileName + "\n")
+                        .str();
+  Key += Code;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (auto Memo = FindMemo(); Memo != Memos.end()) {
+      auto It = Memo->Results.find(Key);
+      if (It != Memo->Results.end())
+        return It->second;
+    }
+  }
+
+  auto Result = internal::reformat(Style, Code, Ranges, FirstStartColumn,
+                                   NextStartColumn, LastStartColumn, FileName,
+                                   Status);
+  size_t Bytes = Key.size();
+  for (const tooling::Replacement &R : Result.first)
+    Bytes += R.getReplacementText().size() + sizeof(R);
+  if (Bytes > MaxBytes)
+    return Result;
+  std::lock_guard<std::mutex> Lock(Mutex);
+  if (MemoBytes + Bytes > MaxBytes) {
+    Memos.clear();
+    MemoBytes = 0;
+  }
+
+  auto Memo = FindMemo();
+  if (Memo == Memos.end()) {
+    if (Memos.size() == MaxStyles) {
+      Memos.clear();
+      MemoBytes = 0;
+    }
+    Memos.push_back({Style, {}});
+    Memo = std::prev(Memos.end());
+  }
+  if (Memo->Results.try_emplace(Key, Result).second)
+    MemoBytes += Bytes;
+  return Result;
+}
+
+unsigned ContinuationIndenter::reformatRawStringLiteral(
+]=])
+change_replace(
+[=[
+  std::pair<tooling::Replacements, unsigned> Fixes = internal::reformat(
+]=]
+[=[
+  std::pair<tooling::Replacements, unsigned> Fixes = reformatRawText(
+]=])
+change_end()
+
+# Compiled include regexes. Every include sort builds an
+# IncludeCategoryManager, which compiled the regex of each category of the
+# style again for every file, as well as IncludeIsMainSourceRegex, and
+# IncludeIsMainRegex for each include that may be the main header. A style
+# can now carry its regexes compiled in IncludeStyle::Compiled, which the
+# library sets on the styles it caches; managers of such a style share them,
+# and compile their own otherwise. The main header regexes are compiled once
+# per header stem. The common categories that are a literal, optionally
+# anchored at the start or followed by ".*", are matched without the regex
+# engine.
+change_begin(clang/include/clang/Tooling/Inclusions/IncludeStyle.h)
+change_replace(
+[=[
+struct IncludeStyle {
+]=]
+[=[
+class CompiledIncludeStyle;
+
+struct IncludeStyle {
+]=])
+change_insert_after(
+[=[
+  MainIncludeCharDiscovery MainIncludeChar;
+]=]
+[=[
+
+  /// The regular expressions of this style, compiled once by whoever caches
+  /// the style. Not an option: copies of the style share them, and
+  /// IncludeCategoryManager ignores them if the patterns no longer match.
+  std::shared_ptr<const CompiledIncludeStyle> Compiled;
+]=])
+change_end()
+
+change_begin(clang/include/clang/Tooling/Inclusions/HeaderIncludes.h)
+change_insert_after(
+[=[
+#include "clang/Tooling/Inclusions/IncludeStyle.h"
+]=]
+[=[
+#include "llvm/ADT/StringMap.h"
+#include <mutex>
+]=])
+change_insert_after(
+[=[
+namespace clang {
+namespace tooling {
+]=]
+[=[
+
+/// A regular expression of an include category.
+class CategoryRegex {
+public:
+  CategoryRegex(StringRef Pattern, unsigned Flags = llvm::Regex::NoFlags)
+      : IgnoreCase(Flags & llvm::Regex::IgnoreCase) {
+    if (!parseLiteral(Pattern))
+      Regex = std::make_shared<const llvm::Regex>(Pattern, Flags);
+  }
+
+  bool match(StringRef String) const {
+    switch (Kind) {
+    case MatchKind::Prefix:
+      return IgnoreCase ? String.starts_with_insensitive(Literal)
+                        : String.starts_with(Literal);
+    case MatchKind::Substring:
+      return IgnoreCase ? String.contains_insensitive(Literal)
+                        : String.contains(Literal);
+    case MatchKind::Regex:
+      break;
+    }
+    return Regex->match(String);
+  }
+
+private:
+  // Recognizes "literal" and "^literal", either optionally followed by ".*",
+  // where the literal may escape punctuation with a backslash.
+  bool parseLiteral(StringRef Pattern) {
+    if (Pattern.empty())
+      return false;
+    const bool Anchored = Pattern.consume_front("^");
+    Pattern.consume_back(".*");
+
+    std::string Text;
+    for (size_t I = 0; I < Pattern.size(); ++I) {
+      char C = Pattern[I];
+      if (C == '\\') {
+        if (++I == Pattern.size() ||
+            !StringRef("\\.[]()*+?{}|^$/-\"<>").contains(Pattern[I]))
+          return false;
+        C = Pattern[I];
+      } else if (StringRef(".[]()*+?{}|^$").contains(C)) {
+        return false;
+      }
+      Text += C;
+    }
+
+    Kind = Anchored ? MatchKind::Prefix : MatchKind::Substring;
+    Literal = std::move(Text);
+    return true;
+  }
+
+  enum class MatchKind { Regex, Prefix, Substring };
+
+  MatchKind Kind = MatchKind::Regex;
+  bool IgnoreCase;
+  std::string Literal;
+  std::shared_ptr<const llvm::Regex> Regex;
+};
+
+/// The regular expressions of an IncludeStyle, compiled once and shared by the
+/// copies of the style.
+class CompiledIncludeStyle {
+public:
+  explicit CompiledIncludeStyle(const IncludeStyle &Style)
+      : IncludeCategories(Style.IncludeCategories),
+        IncludeIsMainRegex(Style.IncludeIsMainRegex),
+        IncludeIsMainSourceRegex(Style.IncludeIsMainSourceRegex),
+        MainSourceRegex(Style.IncludeIsMainSourceRegex) {
+    for (const IncludeStyle::IncludeCategory &Category : IncludeCategories) {
+      Categories.emplace_back(Category.Regex, Category.RegexIsCaseSensitive
+                                                  ? llvm::Regex::NoFlags
+                                                  : llvm::Regex::IgnoreCase);
+    }
+  }
+
+  /// Whether these were compiled from the patterns of `Style`.
+  bool matches(const IncludeStyle &Style) const {
+    return Style.IncludeCategories == IncludeCategories &&
+           Style.IncludeIsMainRegex == IncludeIsMainRegex &&
+           Style.IncludeIsMainSourceRegex == IncludeIsMainSourceRegex;
+  }
+
+  ArrayRef<CategoryRegex> categories() const { return Categories; }
+
+  const llvm::Regex &mainSourceRegex() const { return MainSourceRegex; }
+
+  /// Returns the regex matching the stems of the files whose main header has
+  /// the stem `HeaderStem`.
+  std::shared_ptr<const llvm::Regex>
+  mainIncludeRegex(StringRef HeaderStem) const {
+    // Bounded for a style used on many files with different main headers.
+    constexpr size_t MaxStems = 256;
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (MainIncludeRegexes.size() >= MaxStems &&
+        !MainIncludeRegexes.count(HeaderStem))
+      MainIncludeRegexes.clear();
+    std::shared_ptr<const llvm::Regex> &Entry = MainIncludeRegexes[HeaderStem];
+    if (!Entry) {
+      Entry = std::make_shared<const llvm::Regex>(
+          HeaderStem.str() + IncludeIsMainRegex, llvm::Regex::IgnoreCase);
+    }
+    return Entry;
+  }
+
+private:
+  std::vector<IncludeStyle::IncludeCategory> IncludeCategories;
+  std::string IncludeIsMainRegex;
+  std::string IncludeIsMainSourceRegex;
+  SmallVector<CategoryRegex, 4> Categories;
+  llvm::Regex MainSourceRegex;
+
+  mutable std::mutex Mutex;
+  mutable llvm::StringMap<std::shared_ptr<const llvm::Regex>>
+      MainIncludeRegexes;
+};
+
+/// The compiled regexes of an IncludeCategoryManager: those its style carries
+/// when they match its patterns, or its own. The categories are compiled
+/// with them, so emplace_back() leaves the manager's loop over them nothing
+/// to do.
+class IncludeRegexes {
+public:
+  explicit IncludeRegexes(const IncludeStyle &Style)
+      : Compiled(Style.Compiled && Style.Compiled->matches(Style)
+                     ? Style.Compiled
+                     : std::make_shared<const CompiledIncludeStyle>(Style)) {}
+
+  void emplace_back(StringRef, unsigned) {}
+  size_t size() const { return Compiled->categories().size(); }
+  const CategoryRegex &operator[](size_t I) const {
+    return Compiled->categories()[I];
+  }
+
+  const CompiledIncludeStyle &operator*() const { return *Compiled; }
+  const CompiledIncludeStyle *operator->() const { return Compiled.get(); }
+
+private:
+  std::shared_ptr<const CompiledIncludeStyle> Compiled;
+};
+]=])
+change_replace(
+[=[
+  SmallVector<llvm::Regex, 4> CategoryRegexs;
+]=]
+[=[
+  IncludeRegexes CategoryRegexs{Style};
+]=])
+change_end()
+
+change_begin(clang/lib/Tooling/Inclusions/HeaderIncludes.cpp)
+change_replace(
+[=[
+    llvm::Regex MainFileRegex(Style.IncludeIsMainSourceRegex);
+]=]
+[=[
+    const llvm::Regex &MainFileRegex = CategoryRegexs->mainSourceRegex();
+]=])
+change_replace(
+[=[
+    llvm::Regex MainIncludeRegex(HeaderStem.str() + Style.IncludeIsMainRegex,
+                                 llvm::Regex::IgnoreCase);
+]=]
+[=[
+    std::shared_ptr<const llvm::Regex> MainIncludeRegexPtr =
+        CategoryRegexs->mainIncludeRegex(HeaderStem);
+    const llvm::Regex &MainIncludeRegex = *MainIncludeRegexPtr;
+]=])
+change_end()
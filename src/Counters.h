@@ -0,0 +1,35 @@
+#ifndef CLANG_FORMAT_WASM_COUNTERS_H_
+#define CLANG_FORMAT_WASM_COUNTERS_H_
+
+namespace clang {
+namespace format {
+
+// Work counters and hooks added to the clang-format sources by
+// scripts/patch_llvm.cmake. Counters only grow and are kept per thread, so the
+// work of a call is the difference of two readings on the thread that runs it.
+
+// Passes of the unwrapped line parser over a file, one per combination of
+// preprocessor branches it parses.
+unsigned long long &parsePassCount();
+
+// Unwrapped lines produced by the parser, over all passes.
+unsigned long long &unwrappedLineCount();
+
+// States created by the line breaking search of the optimizing formatter.
+unsigned long long &penaltyStateCount();
+
+// Receives the time and the states of the line breaking search of each
+// unwrapped line spanning the source lines [FromLine, ToLine], 1-based, less
+// those of the lines searched within it. A line may be searched several
+// times, e.g. as a child of different states of its parent.
+using LineCostCallback = void (*)(void *Context, unsigned FromLine,
+                                  unsigned ToLine, double Milliseconds,
+                                  unsigned long long States);
+
+// Sets the callback of the current thread, or clears it with nullptr.
+void setLineCostCallback(LineCostCallback Callback, void *Context);
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_COUNTERS_H_
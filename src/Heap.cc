@@ -0,0 +1,159 @@
+#include "Heap.h"
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/heap.h>
+#endif
+
+namespace clang {
+namespace format {
+namespace {
+
+struct Counters {
+  std::atomic<unsigned long long> AllocatedBytes{0};
+  std::atomic<unsigned long long> FreedBytes{0};
+  std::atomic<unsigned long long> Allocations{0};
+  std::atomic<unsigned long long> Frees{0};
+  std::atomic<unsigned long long> Peak{0};
+  std::atomic<unsigned long long> Watermark{0};
+};
+
+// Constant-initialized, so it is usable by allocations made during static
+// initialization of other translation units.
+Counters Heap;
+
+void raiseTo(std::atomic<unsigned long long> &Mark, unsigned long long Live) {
+  unsigned long long Seen = Mark.load(std::memory_order_relaxed);
+  while (Seen < Live &&
+         !Mark.compare_exchange_weak(Seen, Live, std::memory_order_relaxed))
+    ;
+}
+
+void *track(void *Ptr) {
+  if (!Ptr)
+    return nullptr;
+  unsigned long long Size = malloc_usable_size(Ptr);
+  unsigned long long Allocated =
+      Heap.AllocatedBytes.fetch_add(Size, std::memory_order_relaxed) + Size;
+  Heap.Allocations.fetch_add(1, std::memory_order_relaxed);
+
+  unsigned long long Live =
+      Allocated - Heap.FreedBytes.load(std::memory_order_relaxed);
+  raiseTo(Heap.Peak, Live);
+  raiseTo(Heap.Watermark, Live);
+  return Ptr;
+}
+
+void untrack(void *Ptr) {
+  if (!Ptr)
+    return;
+  Heap.FreedBytes.fetch_add(malloc_usable_size(Ptr),
+                            std::memory_order_relaxed);
+  Heap.Frees.fetch_add(1, std::memory_order_relaxed);
+  free(Ptr);
+}
+
+void *allocate(std::size_t Size) noexcept {
+  return track(malloc(Size ? Size : 1));
+}
+
+void *allocateAligned(std::size_t Size, std::align_val_t Align) noexcept {
+  void *Ptr = nullptr;
+  std::size_t Alignment = static_cast<std::size_t>(Align);
+  if (Alignment < sizeof(void *))
+    Alignment = sizeof(void *);
+  if (posix_memalign(&Ptr, Alignment, Size ? Size : 1) != 0)
+    return nullptr;
+  return track(Ptr);
+}
+
+template <typename Pointer> Pointer *orThrow(Pointer *Ptr) {
+  if (!Ptr)
+    throw std::bad_alloc();
+  return Ptr;
+}
+
+unsigned long long liveBytes() {
+  return Heap.AllocatedBytes.load(std::memory_order_relaxed) -
+         Heap.FreedBytes.load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+HeapStats heapStats() {
+  HeapStats Stats{};
+  Stats.allocated_bytes = Heap.AllocatedBytes.load(std::memory_order_relaxed);
+  Stats.freed_bytes = Heap.FreedBytes.load(std::memory_order_relaxed);
+  Stats.allocations = Heap.Allocations.load(std::memory_order_relaxed);
+  Stats.frees = Heap.Frees.load(std::memory_order_relaxed);
+  Stats.current_bytes = liveBytes();
+  Stats.peak_bytes = Heap.Peak.load(std::memory_order_relaxed);
+#ifdef __EMSCRIPTEN__
+  Stats.memory_bytes = emscripten_get_heap_size();
+#endif
+  return Stats;
+}
+
+unsigned long long resetHeapWatermark() {
+  unsigned long long Live = liveBytes();
+  Heap.Watermark.store(Live, std::memory_order_relaxed);
+  return Live;
+}
+
+unsigned long long heapWatermark() {
+  return Heap.Watermark.load(std::memory_order_relaxed);
+}
+
+} // namespace format
+} // namespace clang
+
+using clang::format::allocate;
+using clang::format::allocateAligned;
+using clang::format::orThrow;
+using clang::format::untrack;
+
+void *operator new(std::size_t Size) { return orThrow(allocate(Size)); }
+void *operator new[](std::size_t Size) { return orThrow(allocate(Size)); }
+void *operator new(std::size_t Size, std::align_val_t Align) {
+  return orThrow(allocateAligned(Size, Align));
+}
+void *operator new[](std::size_t Size, std::align_val_t Align) {
+  return orThrow(allocateAligned(Size, Align));
+}
+
+void *operator new(std::size_t Size, const std::nothrow_t &) noexcept {
+  return allocate(Size);
+}
+void *operator new[](std::size_t Size, const std::nothrow_t &) noexcept {
+  return allocate(Size);
+}
+void *operator new(std::size_t Size, std::align_val_t Align,
+                   const std::nothrow_t &) noexcept {
+  return allocateAligned(Size, Align);
+}
+void *operator new[](std::size_t Size, std::align_val_t Align,
+                     const std::nothrow_t &) noexcept {
+  return allocateAligned(Size, Align);
+}
+
+void operator delete(void *Ptr) noexcept { untrack(Ptr); }
+void operator delete[](void *Ptr) noexcept { untrack(Ptr); }
+void operator delete(void *Ptr, std::size_t) noexcept { untrack(Ptr); }
+void operator delete[](void *Ptr, std::size_t) noexcept { untrack(Ptr); }
+void operator delete(void *Ptr, std::align_val_t) noexcept { untrack(Ptr); }
+void operator delete[](void *Ptr, std::align_val_t) noexcept { untrack(Ptr); }
+void operator delete(void *Ptr, std::size_t, std::align_val_t) noexcept {
+  untrack(Ptr);
+}
+void operator delete[](void *Ptr, std::size_t, std::align_val_t) noexcept {
+  untrack(Ptr);
+}
+void operator delete(void *Ptr, const std::nothrow_t &) noexcept {
+  untrack(Ptr);
+}
+void operator delete[](void *Ptr, const std::nothrow_t &) noexcept {
+  untrack(Ptr);
+}
@@ -0,0 +1,27 @@
+#ifndef CLANG_FORMAT_WASM_HEAP_H_
+#define CLANG_FORMAT_WASM_HEAP_H_
+
+#include "lib.h"
+
+namespace clang {
+namespace format {
+
+// Heap accounting for everything allocated through operator new, which covers
+// LLVM and clang as well as the bindings. Allocations made with malloc
+// directly are only visible in the linear memory size.
+
+// Returns the totals since the module was instantiated.
+HeapStats heapStats();
+
+// Starts a new watermark at the current live bytes and returns them.
+// The watermark rises with the live bytes until it is reset again, which lets
+// a call measure its own peak without touching the global one.
+unsigned long long resetHeapWatermark();
+
+// Returns the highest live bytes since the last resetHeapWatermark().
+unsigned long long heapWatermark();
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_HEAP_H_
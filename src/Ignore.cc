@@ -0,0 +1,113 @@
+#include "Ignore.h"
+#include "clang/../../lib/Format/MatchFilePath.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
+using namespace llvm::sys;
+
+namespace clang {
+namespace format {
+
+static constexpr auto PosixStyle = path::Style::posix;
+
+// Returns `Path` as an absolute path of the tree.
+static auto absolutePath(StringRef Path) -> SmallString<128> {
+  SmallString<128> Absolute("/");
+  path::append(Absolute, PosixStyle, Path);
+  path::remove_dots(Absolute, /*remove_dot_dot=*/true, PosixStyle);
+  return Absolute;
+}
+
+IgnoreFile::IgnoreFile(StringRef Directory, StringRef Content) {
+  SmallVector<StringRef> Lines;
+  Content.split(Lines, '\n');
+
+  for (StringRef Line : Lines) {
+    StringRef Glob = Line.trim();
+    // Skip empty and comment lines.
+    if (Glob.empty() || Glob[0] == '#')
+      continue;
+
+    const bool Negated = Glob[0] == '!';
+    if (Negated)
+      Glob = Glob.drop_front();
+    if (Glob.empty())
+      continue;
+    Glob = Glob.ltrim();
+
+    // `Glob` is relative to `Directory` unless it starts with a slash.
+    SmallString<128> Absolute;
+    if (Glob[0] == '/') {
+      Absolute = Glob;
+    } else {
+      Absolute = Directory;
+      path::append(Absolute, PosixStyle, Glob);
+      path::remove_dots(Absolute, /*remove_dot_dot=*/true, PosixStyle);
+    }
+
+    const bool Literal =
+        Absolute.str().find_first_of("\\?*[") == StringRef::npos;
+    Patterns.push_back({std::string(Absolute), Negated, Literal});
+  }
+}
+
+bool IgnoreFile::matches(StringRef Path) const {
+  for (const Pattern &P : Patterns) {
+    const bool Matched =
+        P.Literal ? Path == P.Glob : matchFilePath(P.Glob, Path);
+    if (Matched == !P.Negated)
+      return true;
+  }
+  return false;
+}
+
+void IgnoreMatcher::add(StringRef Directory, StringRef Content) {
+  SmallString<128> Absolute = absolutePath(Directory);
+  Files.insert_or_assign(std::string(Absolute), IgnoreFile(Absolute, Content));
+}
+
+void IgnoreMatcher::remove(StringRef Directory) {
+  Files.erase(std::string(absolutePath(Directory)));
+}
+
+const IgnoreFile *IgnoreMatcher::nearest(StringRef Directory) const {
+  for (; !Directory.empty();
+       Directory = path::parent_path(Directory, PosixStyle)) {
+    auto It = Files.find(Directory);
+    if (It != Files.end())
+      return &It->second;
+  }
+  return nullptr;
+}
+
+bool IgnoreMatcher::isIgnored(StringRef Path) const {
+  if (Files.empty())
+    return false;
+  SmallString<128> Absolute = absolutePath(Path);
+  const IgnoreFile *File = nearest(path::parent_path(Absolute, PosixStyle));
+  return File && File->matches(Absolute);
+}
+
+std::vector<bool>
+IgnoreMatcher::isIgnored(const std::vector<std::string> &Paths) const {
+  std::vector<bool> Ignored(Paths.size(), false);
+  if (Files.empty())
+    return Ignored;
+
+  SmallString<128> PrevDir;
+  const IgnoreFile *File = nullptr;
+  for (size_t Index = 0; Index < Paths.size(); ++Index) {
+    SmallString<128> Absolute = absolutePath(Paths[Index]);
+    StringRef Dir = path::parent_path(Absolute, PosixStyle);
+    if (Index == 0 || Dir != PrevDir) {
+      PrevDir = Dir;
+      File = nearest(Dir);
+    }
+    Ignored[Index] = File && File->matches(Absolute);
+  }
+  return Ignored;
+}
+
+} // namespace format
+} // namespace clang
@@ -0,0 +1,67 @@
+#ifndef CLANG_FORMAT_WASM_IGNORE_H_
+#define CLANG_FORMAT_WASM_IGNORE_H_
+
+#include "llvm/ADT/StringRef.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace format {
+
+// The patterns of one .clang-format-ignore file, parsed once:
+// - A blank line is skipped.
+// - Leading and trailing spaces of a line are trimmed.
+// - A line starting with a hash (`#`) is a comment.
+// - A non-comment line is a single pattern.
+// - The slash (`/`) is used as the directory separator.
+// - A pattern is relative to the directory of the .clang-format-ignore file (or
+//   the root directory if the pattern starts with a slash).
+// - A pattern is negated if it starts with a bang (`!`).
+class IgnoreFile {
+public:
+  // `Directory` is the absolute directory of the file, using slashes.
+  IgnoreFile(llvm::StringRef Directory, llvm::StringRef Content);
+
+  // Returns whether `Path`, absolute and using slashes, is ignored.
+  bool matches(llvm::StringRef Path) const;
+
+private:
+  struct Pattern {
+    std::string Glob;
+    bool Negated;
+    // Without meta characters the glob only matches itself.
+    bool Literal;
+  };
+
+  std::vector<Pattern> Patterns;
+};
+
+// The .clang-format-ignore files of a directory tree that does not live on a
+// file system. Like the CLI, a path is only matched against the nearest file
+// in its directory or above.
+class IgnoreMatcher {
+public:
+  // Registers the file of `Directory`, replacing any previous one.
+  void add(llvm::StringRef Directory, llvm::StringRef Content);
+  void remove(llvm::StringRef Directory);
+  bool empty() const { return Files.empty(); }
+
+  // Returns whether `Path` is ignored. Relative paths are relative to the
+  // root of the tree.
+  bool isIgnored(llvm::StringRef Path) const;
+
+  // Returns whether each of `Paths` is ignored. Consecutive paths in the same
+  // directory share the lookup of their ignore file.
+  std::vector<bool> isIgnored(const std::vector<std::string> &Paths) const;
+
+private:
+  const IgnoreFile *nearest(llvm::StringRef Directory) const;
+
+  std::map<std::string, IgnoreFile, std::less<>> Files;
+};
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_IGNORE_H_
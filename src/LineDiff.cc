@@ -0,0 +1,132 @@
+#include "LineDiff.h"
+#include "llvm/ADT/Hashing.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace clang {
+namespace format {
+namespace {
+
+// Beyond this many edits the diff is abandoned and everything between the
+// common prefix and suffix counts as changed; the trace of the Myers diff
+// grows with the square of the edit count.
+constexpr int MaxEdits = 2000;
+
+struct Line {
+  StringRef Text;
+  size_t Hash;
+
+  bool operator==(const Line &Other) const {
+    return Hash == Other.Hash && Text == Other.Text;
+  }
+};
+
+std::vector<Line> splitLines(StringRef Code) {
+  std::vector<Line> Lines;
+  while (!Code.empty()) {
+    auto [Text, Rest] = Code.split('\n');
+    Lines.push_back({Text, hash_value(Text)});
+    Code = Rest;
+  }
+  return Lines;
+}
+
+// Marks the lines of `B` that a shortest edit script from `A` inserts, at
+// `Inserted[Offset + Index]`. Returns false if that script needs more than
+// MaxEdits edits.
+bool markInserted(ArrayRef<Line> A, ArrayRef<Line> B,
+                  std::vector<bool> &Inserted, size_t Offset) {
+  const int N = A.size();
+  const int M = B.size();
+  const int Max = std::min(N + M, MaxEdits);
+
+  // `V[Max + K]` is the furthest x on diagonal K; `Trace[D]` is a copy of the
+  // diagonals [-D, D] after D edits.
+  std::vector<int> V(2 * Max + 2, 0);
+  std::vector<std::vector<int>> Trace;
+
+  for (int D = 0; D <= Max; ++D) {
+    for (int K = -D; K <= D; K += 2) {
+      int X = (K == -D || (K != D && V[Max + K - 1] < V[Max + K + 1]))
+                  ? V[Max + K + 1]
+                  : V[Max + K - 1] + 1;
+      int Y = X - K;
+      while (X < N && Y < M && A[X] == B[Y])
+        ++X, ++Y;
+      V[Max + K] = X;
+
+      if (X < N || Y < M)
+        continue;
+
+      Trace.emplace_back(V.begin() + Max - D, V.begin() + Max + D + 1);
+      for (int Step = D; Step > 0; --Step) {
+        const std::vector<int> &Prev = Trace[Step - 1];
+        auto PrevAt = [&](int PrevK) { return Prev[PrevK + Step - 1]; };
+
+        int K = X - Y;
+        int PrevK = (K == -Step || (K != Step && PrevAt(K - 1) < PrevAt(K + 1)))
+                        ? K + 1
+                        : K - 1;
+        int PrevX = PrevAt(PrevK);
+        int PrevY = PrevX - PrevK;
+        while (X > PrevX && Y > PrevY)
+          --X, --Y;
+        if (X == PrevX)
+          Inserted[Offset + PrevY] = true;
+        X = PrevX;
+        Y = PrevY;
+      }
+      return true;
+    }
+    Trace.emplace_back(V.begin() + Max - D, V.begin() + Max + D + 1);
+  }
+  return false;
+}
+
+} // namespace
+
+std::vector<tooling::Range> changedRanges(StringRef Old, StringRef New) {
+  const std::vector<Line> A = splitLines(Old);
+  const std::vector<Line> B = splitLines(New);
+
+  size_t Prefix = 0;
+  while (Prefix < A.size() && Prefix < B.size() && A[Prefix] == B[Prefix])
+    ++Prefix;
+  size_t Suffix = 0;
+  while (Suffix < A.size() - Prefix && Suffix < B.size() - Prefix &&
+         A[A.size() - 1 - Suffix] == B[B.size() - 1 - Suffix])
+    ++Suffix;
+
+  ArrayRef<Line> OldMiddle =
+      ArrayRef<Line>(A).slice(Prefix, A.size() - Prefix - Suffix);
+  ArrayRef<Line> NewMiddle =
+      ArrayRef<Line>(B).slice(Prefix, B.size() - Prefix - Suffix);
+
+  std::vector<bool> Changed(B.size(), false);
+  if (OldMiddle.empty() ||
+      (!NewMiddle.empty() &&
+       !markInserted(OldMiddle, NewMiddle, Changed, Prefix))) {
+    std::fill(Changed.begin() + Prefix, Changed.end() - Suffix, true);
+  }
+
+  std::vector<tooling::Range> Ranges;
+  for (size_t Index = 0; Index < B.size();) {
+    if (!Changed[Index]) {
+      ++Index;
+      continue;
+    }
+    size_t Last = Index;
+    while (Last + 1 < B.size() && Changed[Last + 1])
+      ++Last;
+
+    const unsigned Begin = B[Index].Text.data() - New.data();
+    const unsigned End = B[Last].Text.end() - New.data();
+    Ranges.push_back(tooling::Range(Begin, End - Begin));
+    Index = Last + 1;
+  }
+  return Ranges;
+}
+
+} // namespace format
+} // namespace clang
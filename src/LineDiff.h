@@ -0,0 +1,21 @@
+#ifndef CLANG_FORMAT_WASM_LINE_DIFF_H_
+#define CLANG_FORMAT_WASM_LINE_DIFF_H_
+
+#include "clang/Tooling/Core/Replacement.h"
+#include "llvm/ADT/StringRef.h"
+#include <vector>
+
+namespace clang {
+namespace format {
+
+// Returns the byte ranges of `New` covering the lines that were added or
+// changed since `Old`, like the `-lines` git-clang-format derives from a
+// zero-context diff. Lines are compared by hash with a Myers diff after
+// trimming the common prefix and suffix; removed lines yield no range.
+std::vector<tooling::Range> changedRanges(llvm::StringRef Old,
+                                          llvm::StringRef New);
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_LINE_DIFF_H_
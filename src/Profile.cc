@@ -0,0 +1,67 @@
+#include "Profile.h"
+#include "Counters.h"
+#include "llvm/Support/Format.h"
+#include <algorithm>
+
+namespace clang {
+namespace format {
+namespace {
+
+// Sums the searches of each unwrapped line, keyed by its first source line.
+void addLineCost(void *Context, unsigned FromLine, unsigned ToLine,
+                 double Milliseconds, unsigned long long States) {
+  auto &Costs = *static_cast<std::map<unsigned, LineCost> *>(Context);
+  auto [It, Inserted] =
+      Costs.try_emplace(FromLine, LineCost{FromLine, ToLine, 0, 0});
+  It->second.ToLine = std::max(It->second.ToLine, ToLine);
+  It->second.Milliseconds += Milliseconds;
+  It->second.States += States;
+}
+
+} // namespace
+
+LineCostCollector::LineCostCollector() {
+  setLineCostCallback(addLineCost, &Costs);
+}
+
+LineCostCollector::~LineCostCollector() {
+  setLineCostCallback(nullptr, nullptr);
+}
+
+std::vector<LineCost> LineCostCollector::hottest(unsigned Count) const {
+  std::vector<LineCost> Hot;
+  for (const auto &[Line, Cost] : Costs)
+    Hot.push_back(Cost);
+  std::sort(Hot.begin(), Hot.end(),
+            [](const LineCost &LHS, const LineCost &RHS) {
+              if (LHS.Milliseconds != RHS.Milliseconds)
+                return LHS.Milliseconds > RHS.Milliseconds;
+              return LHS.States > RHS.States;
+            });
+  if (Hot.size() > Count)
+    Hot.resize(Count);
+  return Hot;
+}
+
+std::vector<LineCost> profileLines(const FormatStyle &Style, StringRef Code,
+                                   StringRef FileName, unsigned Count) {
+  if (Code.empty() || Count == 0)
+    return {};
+
+  LineCostCollector Collector;
+  reformat(Style, Code, {tooling::Range(0, Code.size())}, FileName);
+  return Collector.hottest(Count);
+}
+
+void printLineCosts(llvm::raw_ostream &OS, const std::vector<LineCost> &Costs) {
+  for (const LineCost &Cost : Costs) {
+    OS << llvm::format("%10.3f ms %10llu states  line %u", Cost.Milliseconds,
+                       Cost.States, Cost.FromLine);
+    if (Cost.ToLine != Cost.FromLine)
+      OS << '-' << Cost.ToLine;
+    OS << '\n';
+  }
+}
+
+} // namespace format
+} // namespace clang
@@ -0,0 +1,52 @@
+#ifndef CLANG_FORMAT_WASM_PROFILE_H_
+#define CLANG_FORMAT_WASM_PROFILE_H_
+
+#include "clang/Format/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <vector>
+
+namespace clang {
+namespace format {
+
+// Line breaking cost of the unwrapped line spanning the source lines
+// [FromLine, ToLine], 1-based.
+struct LineCost {
+  unsigned FromLine;
+  unsigned ToLine;
+  double Milliseconds;
+  unsigned long long States;
+};
+
+// Collects the line costs reported by the patched line formatter on the
+// current thread while it is alive, see setLineCostCallback(). Each entry has
+// the time and the states of the line breaking search of a line, excluding
+// the lines searched within it. Parsing and annotation are not attributed to
+// lines.
+class LineCostCollector {
+public:
+  LineCostCollector();
+  ~LineCostCollector();
+  LineCostCollector(const LineCostCollector &) = delete;
+  LineCostCollector &operator=(const LineCostCollector &) = delete;
+
+  // The `Count` lines that cost the most so far, most expensive first.
+  std::vector<LineCost> hottest(unsigned Count) const;
+
+private:
+  std::map<unsigned, LineCost> Costs;
+};
+
+// Finds the `Count` unwrapped lines of `Code` that cost the most to reformat
+// by reformatting it once under a LineCostCollector. `Code` must be what
+// would be passed to reformat(), e.g. with the JSON prefix already inserted.
+std::vector<LineCost> profileLines(const FormatStyle &Style, StringRef Code,
+                                   StringRef FileName, unsigned Count);
+
+// Prints `Costs` one line per entry, in the given order.
+void printLineCosts(llvm::raw_ostream &OS, const std::vector<LineCost> &Costs);
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_PROFILE_H_
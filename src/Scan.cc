@@ -0,0 +1,950 @@
+#include "Scan.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Unicode.h"
+#include <algorithm>
+#include <string>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace llvm;
+
+namespace clang {
+namespace format {
+
+namespace {
+
+bool isIdentifierChar(char C) { return isAlnum(C) || C == '_'; }
+
+// Returns whether the 'R' at `Pos` is preceded by nothing but an optional
+// encoding prefix of a raw string literal.
+bool isRawStringPrefix(StringRef Code, size_t Pos) {
+  size_t Start = Pos;
+  while (Start > 0 && isIdentifierChar(Code[Start - 1]))
+    --Start;
+  StringRef Prefix = Code.slice(Start, Pos);
+  return Prefix.empty() || Prefix == "L" || Prefix == "u" || Prefix == "U" ||
+         Prefix == "u8";
+}
+
+// Returns the position just past the literal or comment starting at `Pos`,
+// or `Pos` if none starts there.
+size_t skipLiteralOrComment(StringRef Code, size_t Pos) {
+  const char C = Code[Pos];
+  const char Next = Pos + 1 < Code.size() ? Code[Pos + 1] : 0;
+
+  if (C == '/' && Next == '/') {
+    size_t End = Code.find('\n', Pos);
+    return End == StringRef::npos ? Code.size() : End;
+  }
+
+  if (C == '/' && Next == '*') {
+    size_t End = Code.find("*/", Pos + 2);
+    return End == StringRef::npos ? Code.size() : End + 2;
+  }
+
+  // C++ raw string: R"delimiter( ... )delimiter", maybe with a prefix.
+  if (C == 'R' && Next == '"' && isRawStringPrefix(Code, Pos)) {
+    size_t Open = Code.find('(', Pos + 2);
+    if (Open == StringRef::npos || Open - Pos - 2 > 16)
+      return Pos;
+    std::string Close = ")";
+    Close += Code.slice(Pos + 2, Open);
+    Close += '"';
+    size_t End = Code.find(Close, Open + 1);
+    return End == StringRef::npos ? Code.size() : End + Close.size();
+  }
+
+  // A quote after a digit is a digit separator (1'000'000).
+  if (C == '\'' && Pos > 0 && isDigit(Code[Pos - 1]))
+    return Pos;
+
+  if (C == '"' || C == '\'' || C == '`') {
+    for (size_t I = Pos + 1; I < Code.size(); ++I) {
+      if (Code[I] == '\\')
+        ++I;
+      else if (Code[I] == C)
+        return I + 1;
+      else if (Code[I] == '\n' && C != '`')
+        return I;
+    }
+    return Code.size();
+  }
+
+  return Pos;
+}
+
+// Returns whether `C` may matter to maxNestingDepth(): a bracket, the start of
+// a literal or comment, a character that may open, close or end an angle
+// bracket list, or the first letter of a control statement keyword.
+bool isNestingOrLiteralStart(char C) {
+  switch (C) {
+  case '(':
+  case ')':
+  case '[':
+  case ']':
+  case '{':
+  case '}':
+  case '/':
+  case '"':
+  case '\'':
+  case '`':
+  case 'R':
+  case '<':
+  case '>':
+  case ';':
+  case '#':
+  case 'f':
+  case 'i':
+  case 's':
+  case 'w':
+    return true;
+  default:
+    return false;
+  }
+}
+
+#if defined(__wasm_simd128__) || defined(__SSE2__)
+// Returns a mask of the bytes among the 16 at `P` for which
+// isNestingOrLiteralStart() holds. "()" differ from 0x28 only in the lowest
+// bit, "[]" become "{}" when setting 0x20 and "<>" differ only in bit 0x02.
+unsigned nestingOrLiteralMask(const char *P) {
+#if defined(__wasm_simd128__)
+  const v128_t V = wasm_v128_load(P);
+  const v128_t Paren = wasm_v128_and(V, wasm_i8x16_splat(0xFE));
+  const v128_t Brace = wasm_v128_or(V, wasm_i8x16_splat(0x20));
+  const v128_t Angle = wasm_v128_and(V, wasm_i8x16_splat(0xFD));
+  v128_t M = wasm_i8x16_eq(Paren, wasm_i8x16_splat('('));
+  M = wasm_v128_or(M, wasm_i8x16_eq(Brace, wasm_i8x16_splat('{')));
+  M = wasm_v128_or(M, wasm_i8x16_eq(Brace, wasm_i8x16_splat('}')));
+  M = wasm_v128_or(M, wasm_i8x16_eq(Angle, wasm_i8x16_splat('<')));
+  for (char C : {'/', '"', '\'', '`', 'R', ';', '#', 'f', 'i', 's', 'w'})
+    M = wasm_v128_or(M, wasm_i8x16_eq(V, wasm_i8x16_splat(C)));
+  return wasm_i8x16_bitmask(M);
+#else
+  const __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+  const __m128i Paren = _mm_and_si128(V, _mm_set1_epi8(char(0xFE)));
+  const __m128i Brace = _mm_or_si128(V, _mm_set1_epi8(0x20));
+  const __m128i Angle = _mm_and_si128(V, _mm_set1_epi8(char(0xFD)));
+  __m128i M = _mm_cmpeq_epi8(Paren, _mm_set1_epi8('('));
+  M = _mm_or_si128(M, _mm_cmpeq_epi8(Brace, _mm_set1_epi8('{')));
+  M = _mm_or_si128(M, _mm_cmpeq_epi8(Brace, _mm_set1_epi8('}')));
+  M = _mm_or_si128(M, _mm_cmpeq_epi8(Angle, _mm_set1_epi8('<')));
+  for (char C : {'/', '"', '\'', '`', 'R', ';', '#', 'f', 'i', 's', 'w'})
+    M = _mm_or_si128(M, _mm_cmpeq_epi8(V, _mm_set1_epi8(C)));
+  return _mm_movemask_epi8(M);
+#endif
+}
+#endif
+
+// Returns the position of the first byte at or after `Pos` for which
+// isNestingOrLiteralStart() holds, or the end of `Code`. Most of a source file
+// is neither, so it is skipped 16 bytes at a time where SIMD is available.
+size_t findNestingOrLiteral(StringRef Code, size_t Pos) {
+  const char *Data = Code.data();
+  const size_t Size = Code.size();
+#if defined(__wasm_simd128__) || defined(__SSE2__)
+  for (; Pos + 16 <= Size; Pos += 16) {
+    if (unsigned Mask = nestingOrLiteralMask(Data + Pos))
+      return Pos + llvm::countr_zero(Mask);
+  }
+#endif
+  while (Pos < Size && !isNestingOrLiteralStart(Data[Pos]))
+    ++Pos;
+  return Pos;
+}
+
+// Returns the position just past the preprocessor directive starting at `Pos`,
+// that is before the newline ending its last continued line.
+size_t skipDirective(StringRef Code, size_t Pos) {
+  while (Pos < Code.size() && Code[Pos] != '\n') {
+    if (Code[Pos] == '\\' && Pos + 1 < Code.size() && Code[Pos + 1] == '\n') {
+      Pos += 2;
+      continue;
+    }
+    size_t End = skipLiteralOrComment(Code, Pos);
+    Pos = End == Pos ? Pos + 1 : End;
+  }
+  return Pos;
+}
+
+// Returns whether `Word` is "in" or may be a Foundation name such as NSString,
+// CGFloat, UIView, NS_ENUM or FOUNDATION_EXPORT.
+bool isObjCWord(StringRef Word) {
+  if (Word == "in" || Word.starts_with("FOUNDATION_"))
+    return true;
+  if (Word.size() < 3 || Word.starts_with("UINT"))
+    return false;
+  StringRef Prefix = Word.take_front(2);
+  return (Prefix == "NS" || Prefix == "CG" || Prefix == "CF" ||
+          Prefix == "UI") &&
+         (isUpper(Word[2]) || Word[2] == '_');
+}
+
+// Returns whether the brackets opened at `Pos` may be a message send: they
+// hold two words separated by whitespace, as in [object message] or
+// [[Class alloc] init], or continue on the next line. Nested brackets count as
+// a word, as in [x[0] foo], unless they do not close on the same line.
+bool isMessageSend(StringRef Code, size_t Pos) {
+  bool AfterWord = false;
+  bool AfterSpace = false;
+  for (size_t I = Pos + 1; I < Code.size(); ++I) {
+    const char C = Code[I];
+    if (C == '\n')
+      return true;
+    if (C == '[') {
+      unsigned Depth = 1;
+      for (++I; I < Code.size() && Depth > 0; ++I) {
+        if (Code[I] == '\n')
+          return true;
+        Depth += Code[I] == '[';
+        Depth -= Code[I] == ']';
+      }
+      if (Depth > 0)
+        return true;
+      --I;
+      AfterWord = true;
+      AfterSpace = false;
+      continue;
+    }
+    if (C == ']' || C == ';' || C == '{')
+      return false;
+    if (isIdentifierChar(C) && AfterSpace)
+      return true;
+    if (C == ' ' || C == '\t') {
+      AfterSpace = AfterWord;
+      continue;
+    }
+    AfterWord = isIdentifierChar(C) || C == ')';
+    AfterSpace = false;
+  }
+  return false;
+}
+
+// Returns the position just past the literal or name starting at `Pos`, or
+// `Pos` if none starts there. Names followed by anything but whitespace, a
+// comma or a closing brace are rejected by the caller.
+size_t skipListItem(StringRef Code, size_t Pos) {
+  if (Pos >= Code.size())
+    return Pos;
+  const char C = Code[Pos];
+  const char Next = Pos + 1 < Code.size() ? Code[Pos + 1] : 0;
+
+  // A pp-number: 42, 0x2A, 1'000, 1.5e-3f.
+  if (isDigit(C) || (C == '.' && isDigit(Next))) {
+    size_t End = Pos + 1;
+    while (End < Code.size()) {
+      const char D = Code[End];
+      if (isIdentifierChar(D) || D == '.' ||
+          (D == '\'' && End + 1 < Code.size() &&
+           isIdentifierChar(Code[End + 1])) ||
+          ((D == '+' || D == '-') &&
+           (Code[End - 1] == 'e' || Code[End - 1] == 'E' ||
+            Code[End - 1] == 'p' || Code[End - 1] == 'P')))
+        ++End;
+      else
+        break;
+    }
+    return End;
+  }
+
+  size_t Start = Pos;
+  if (isIdentifierChar(C)) {
+    while (Pos < Code.size() && isIdentifierChar(Code[Pos]))
+      ++Pos;
+    if (Pos == Code.size() || (Code[Pos] != '"' && Code[Pos] != '\''))
+      return Pos;
+    // An encoding prefix, but not of a raw string.
+    StringRef Prefix = Code.slice(Start, Pos);
+    if (Prefix != "L" && Prefix != "u" && Prefix != "U" && Prefix != "u8")
+      return Start;
+  }
+
+  if (Code[Pos] != '"' && Code[Pos] != '\'')
+    return Start;
+  size_t End = skipLiteralOrComment(Code, Pos);
+  if (End < Pos + 2 || Code[End - 1] != Code[Pos])
+    return Start;
+  return End;
+}
+
+// Parses the braced list opened at `Open` into `List`. Returns false if it
+// holds anything but literals and names separated by commas.
+bool parseBracedList(StringRef Code, size_t Open, BracedList &List) {
+  List.Items.clear();
+  size_t Pos = Open + 1;
+  auto skipSpace = [&] {
+    while (Pos < Code.size() && isSpace(Code[Pos]))
+      ++Pos;
+  };
+
+  while (true) {
+    skipSpace();
+    const size_t Begin = Pos;
+    if (Pos < Code.size() && (Code[Pos] == '-' || Code[Pos] == '+'))
+      ++Pos;
+    const size_t End = skipListItem(Code, Pos);
+    if (End == Pos)
+      return false;
+    List.Items.push_back(Code.slice(Begin, End));
+
+    Pos = End;
+    skipSpace();
+    if (Pos == Code.size())
+      return false;
+    if (Code[Pos] == '}') {
+      List.Begin = Open;
+      List.End = Pos;
+      return true;
+    }
+    if (Code[Pos] != ',')
+      return false;
+    ++Pos;
+  }
+}
+
+// Calls `Fn` with each run of identifier characters in `Text` that does not
+// start with a digit.
+template <typename Function>
+void forEachWord(StringRef Text, Function &&Fn) {
+  for (size_t Pos = 0; Pos < Text.size();) {
+    if (!isIdentifierChar(Text[Pos])) {
+      ++Pos;
+      continue;
+    }
+    size_t End = Pos;
+    while (End < Text.size() && isIdentifierChar(Text[End]))
+      ++End;
+    if (!isDigit(Text[Pos]))
+      Fn(Text.slice(Pos, End));
+    Pos = End;
+  }
+}
+
+// Returns whether `Line`, a line of a comment, fits in `ColumnLimit` and ends
+// without whitespace or a line continuation.
+bool isTidyCommentLine(StringRef Line, unsigned ColumnLimit) {
+  if (Line.empty() || Line.contains('\t') || Line.contains('\r') ||
+      isSpace(Line.back()) || Line.back() == '\\')
+    return false;
+  int Width = sys::unicode::columnWidthUTF8(Line);
+  return Width >= 0 && (ColumnLimit == 0 || unsigned(Width) <= ColumnLimit);
+}
+
+// Returns the position of the newline ending the comment that starts the line
+// at `Pos` after `Indent`, or `Pos` if the comment would be changed.
+size_t skipTidyComment(StringRef Code, size_t Pos, StringRef Indent,
+                       unsigned ColumnLimit) {
+  size_t LineEnd = std::min(Code.find('\n', Pos), Code.size());
+  StringRef Line = Code.slice(Pos, LineEnd);
+  if (!Line.starts_with(Indent) || !isTidyCommentLine(Line, ColumnLimit))
+    return Pos;
+  StringRef Text = Line.drop_front(Indent.size());
+
+  if (Text.consume_front("//")) {
+    if (Text.starts_with("/") || Text.starts_with("!"))
+      Text = Text.drop_front();
+    return Text.empty() || Text.front() == ' ' ? LineEnd : Pos;
+  }
+
+  if (!Text.starts_with("/*"))
+    return Pos;
+  const size_t Close = Code.find("*/", Pos + Indent.size() + 2);
+  if (Close == StringRef::npos)
+    return Pos;
+  if (Close < LineEnd)
+    return Close + 2 == LineEnd ? LineEnd : Pos;
+
+  // The following lines continue a '*' under the one of "/*".
+  const std::string Decoration = (Indent + " *").str();
+  while (LineEnd < Close) {
+    size_t Start = LineEnd + 1;
+    LineEnd = std::min(Code.find('\n', Start), Code.size());
+    Line = Code.slice(Start, LineEnd);
+    if (!Line.starts_with(Decoration) || !isTidyCommentLine(Line, ColumnLimit))
+      return Pos;
+    StringRef Rest = Line.drop_front(Decoration.size());
+    if (!Rest.empty() && Rest.front() != ' ' && Rest.front() != '/')
+      return Pos;
+  }
+  return Close + 2 == LineEnd ? LineEnd : Pos;
+}
+
+} // namespace
+
+unsigned maxNestingDepth(StringRef Code) {
+  // What the parser and annotator recurse on at each bracket level besides
+  // the brackets themselves.
+  struct Level {
+    // Control statements whose body has not ended, counting each "else if".
+    unsigned Statements = 0;
+    // Unclosed '<' after a name, up to the end of the statement.
+    unsigned Angles = 0;
+    // Whether the level is the braced body of a control statement of the
+    // level below, which then counts one statement less until it ends.
+    bool IsBody = false;
+  };
+  SmallVector<Level, 16> Levels(1);
+  unsigned Extra = 0;
+  unsigned MaxDepth = 0;
+  auto Deepen = [&](unsigned &Count) {
+    ++Count;
+    ++Extra;
+    MaxDepth = std::max<unsigned>(MaxDepth, Levels.size() - 1 + Extra);
+  };
+  auto Pop = [&] {
+    Extra -= Levels.back().Statements + Levels.back().Angles;
+    bool IsBody = Levels.back().IsBody;
+    Levels.pop_back();
+    if (IsBody) {
+      ++Levels.back().Statements;
+      ++Extra;
+    }
+  };
+  // Ends the statement before `Pos` on the innermost level; an "else" after
+  // it continues the statements of the level.
+  auto EndStatement = [&](size_t Pos) {
+    Level &L = Levels.back();
+    Extra -= L.Angles;
+    L.Angles = 0;
+    for (;;) {
+      Pos = Code.find_first_not_of(" \t\r\n\f\v", Pos);
+      if (Pos == StringRef::npos || Code[Pos] != '/')
+        break;
+      size_t End = skipLiteralOrComment(Code, Pos);
+      if (End == Pos)
+        break;
+      Pos = End;
+    }
+    if (Pos != StringRef::npos && Code.substr(Pos).starts_with("else") &&
+        (Pos + 4 == Code.size() || !isIdentifierChar(Code[Pos + 4])))
+      return;
+    Extra -= L.Statements;
+    L.Statements = 0;
+  };
+
+  for (size_t Pos = findNestingOrLiteral(Code, 0); Pos < Code.size();
+       Pos = findNestingOrLiteral(Code, Pos)) {
+    const char C = Code[Pos];
+    size_t End = skipLiteralOrComment(Code, Pos);
+    if (End != Pos) {
+      Pos = End;
+      continue;
+    }
+
+    // The scan may stop inside a word.
+    if (isIdentifierChar(C)) {
+      size_t WordEnd = Pos;
+      while (WordEnd < Code.size() && isIdentifierChar(Code[WordEnd]))
+        ++WordEnd;
+      if (WordEnd - 1 > Pos && WordEnd < Code.size() &&
+          Code[WordEnd] == '"' && Code[WordEnd - 1] == 'R' &&
+          isRawStringPrefix(Code, WordEnd - 1)) {
+        Pos = WordEnd - 1;
+        continue;
+      }
+      StringRef Word = Code.slice(Pos, WordEnd);
+      const bool AtWordStart = Pos == 0 || !isIdentifierChar(Code[Pos - 1]);
+      if (AtWordStart && (Word == "if" || Word == "for" || Word == "while" ||
+                          Word == "switch"))
+        Deepen(Levels.back().Statements);
+      Pos = WordEnd;
+      continue;
+    }
+
+    switch (C) {
+    case '#':
+      // Not "#if".
+      Pos = std::min(Code.find_first_not_of(" \t", Pos + 1), Code.size());
+      while (Pos < Code.size() && isIdentifierChar(Code[Pos]))
+        ++Pos;
+      continue;
+    case '<':
+      if (Pos + 1 < Code.size() &&
+          (Code[Pos + 1] == '<' || Code[Pos + 1] == '=')) {
+        Pos += 2;
+        continue;
+      }
+      if (Pos > 0 && isIdentifierChar(Code[Pos - 1]))
+        Deepen(Levels.back().Angles);
+      break;
+    case '>':
+      if (Levels.back().Angles > 0 && !(Pos > 0 && Code[Pos - 1] == '-')) {
+        --Levels.back().Angles;
+        --Extra;
+      }
+      break;
+    case ';':
+      EndStatement(Pos + 1);
+      break;
+    case '(':
+    case '[':
+      Levels.emplace_back();
+      MaxDepth = std::max<unsigned>(MaxDepth, Levels.size() - 1 + Extra);
+      break;
+    case '{': {
+      Level &L = Levels.back();
+      Extra -= L.Angles;
+      L.Angles = 0;
+      const bool IsBody = L.Statements > 0;
+      if (IsBody) {
+        --L.Statements;
+        --Extra;
+      }
+      Levels.emplace_back();
+      Levels.back().IsBody = IsBody;
+      MaxDepth = std::max<unsigned>(MaxDepth, Levels.size() - 1 + Extra);
+      break;
+    }
+    case ')':
+    case ']':
+      if (Levels.size() > 1)
+        Pop();
+      break;
+    case '}':
+      if (Levels.size() > 1) {
+        Pop();
+        EndStatement(Pos + 1);
+      }
+      break;
+    }
+    ++Pos;
+  }
+
+  return MaxDepth;
+}
+
+bool mayContainObjC(StringRef Code) {
+  bool LineStart = true;
+  for (size_t Pos = 0; Pos < Code.size();) {
+    const char C = Code[Pos];
+    if (C == '\n') {
+      LineStart = true;
+      ++Pos;
+      continue;
+    }
+    if (C == ' ' || C == '\t') {
+      ++Pos;
+      continue;
+    }
+
+    // A method declaration: - (void)method;
+    if ((C == '-' || C == '+') && LineStart) {
+      size_t Next = Code.find_first_not_of(" \t", Pos + 1);
+      if (Next != StringRef::npos && Code[Next] == '(')
+        return true;
+    }
+    LineStart = false;
+
+    size_t End = skipLiteralOrComment(Code, Pos);
+    if (End != Pos) {
+      Pos = End;
+      continue;
+    }
+
+    if (isIdentifierChar(C)) {
+      size_t WordEnd = Pos;
+      while (WordEnd < Code.size() && isIdentifierChar(Code[WordEnd]))
+        ++WordEnd;
+      if (WordEnd - 1 > Pos && WordEnd < Code.size() &&
+          Code[WordEnd] == '"' && Code[WordEnd - 1] == 'R' &&
+          isRawStringPrefix(Code, WordEnd - 1)) {
+        Pos = WordEnd - 1;
+        continue;
+      }
+      if (isObjCWord(Code.slice(Pos, WordEnd)))
+        return true;
+      Pos = WordEnd;
+      continue;
+    }
+
+    if (C == '@' || C == '^' || (C == '[' && isMessageSend(Code, Pos)))
+      return true;
+    ++Pos;
+  }
+  return false;
+}
+
+StringRef codeForLanguageGuess(StringRef FileName, StringRef Code) {
+  StringRef Extension = llvm::sys::path::extension(FileName);
+  if (!Extension.empty() && Extension != ".h")
+    return Code;
+  // guessLanguage() also honors a "// clang-format Language: ObjC" comment.
+  if (Code.contains("clang-format Language:"))
+    return Code;
+  return mayContainObjC(Code) ? Code : StringRef();
+}
+
+std::vector<RegionBoundary> regionBoundaries(StringRef Code) {
+  struct Candidate {
+    RegionBoundary Boundary;
+    unsigned PPDepth;
+  };
+  std::vector<Candidate> Candidates;
+
+  // Open brackets, holding the scope id of namespace braces and 0 otherwise.
+  std::vector<unsigned> Brackets;
+  unsigned OtherBrackets = 0;
+  unsigned NextScope = 1;
+  bool Unbalanced = false;
+
+  bool AfterUsing = false;
+  bool PendingNamespace = false;
+  // Whether the declaration being scanned, or the one whose outermost brace
+  // is open, only ends at a ';'.
+  bool DeclNeedsSemi = false;
+  bool BraceNeedsSemi = false;
+
+  // The first conditional is an include guard candidate if no code precedes
+  // it. It stops being one when it has more than one branch.
+  enum { NoGuard, InGuard, AfterGuard, NotGuard } Guard = NoGuard;
+  unsigned PPDepth = 0;
+
+  bool SeenCode = false;
+  char LastSignificant = 0;
+  // Newlines since the last token, or 0 once other whitespace followed it.
+  unsigned Newlines = 0;
+  bool LineStart = true;
+
+  auto tokenEnd = [&](char Significant) {
+    if (Significant)
+      LastSignificant = Significant;
+    Newlines = 1;
+  };
+
+  for (size_t Pos = 0; Pos < Code.size();) {
+    const char C = Code[Pos];
+
+    if (C == '\n') {
+      ++Pos;
+      LineStart = true;
+      if (Newlines)
+        ++Newlines;
+      if (Newlines < 3 || Pos == Code.size() || PendingNamespace ||
+          OtherBrackets > 0 ||
+          !(LastSignificant == ';' || LastSignificant == '}' ||
+            LastSignificant == '#'))
+        continue;
+
+      size_t First = Code.find_first_not_of(" \t", Pos);
+      // Declarations start with a name, "::", an attribute, a comment or a
+      // directive; anything else may continue the previous line.
+      if (First == StringRef::npos ||
+          !(isIdentifierChar(Code[First]) || Code[First] == ':' ||
+            Code[First] == '[' || Code[First] == '/' || Code[First] == '#'))
+        continue;
+      bool StartsWithCode = Code[First] != '#' &&
+                            !Code.substr(First).starts_with("//") &&
+                            !Code.substr(First).starts_with("/*");
+      Candidates.push_back({{static_cast<unsigned>(Pos),
+                             Brackets.empty() ? 0 : Brackets.back(),
+                             Newlines - 1, StartsWithCode},
+                            PPDepth});
+      continue;
+    }
+
+    if (C == ' ' || C == '\t' || C == '\f' || C == '\v' || C == '\r') {
+      ++Pos;
+      Newlines = 0;
+      continue;
+    }
+
+    if (C == '#' && LineStart) {
+      size_t Name = Code.find_first_not_of(" \t", Pos + 1);
+      size_t NameEnd = Name;
+      while (NameEnd < Code.size() && isIdentifierChar(Code[NameEnd]))
+        ++NameEnd;
+      StringRef Directive =
+          Name == StringRef::npos ? "" : Code.slice(Name, NameEnd);
+
+      if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef") {
+        if (PPDepth == 0)
+          Guard = Guard == NoGuard && !SeenCode ? InGuard : NotGuard;
+        ++PPDepth;
+      } else if (Directive.starts_with("el")) {
+        if (PPDepth == 1 && Guard == InGuard)
+          Guard = NotGuard;
+      } else if (Directive == "endif" && PPDepth > 0) {
+        if (--PPDepth == 0 && Guard == InGuard)
+          Guard = AfterGuard;
+      }
+
+      Pos = skipDirective(Code, Pos);
+      tokenEnd('#');
+      continue;
+    }
+    LineStart = false;
+
+    size_t End = skipLiteralOrComment(Code, Pos);
+    if (End != Pos) {
+      const bool Comment = C == '/';
+      if (!Comment) {
+        SeenCode = true;
+        AfterUsing = false;
+      }
+      Pos = End;
+      tokenEnd(Comment ? 0 : '"');
+      continue;
+    }
+
+    SeenCode = true;
+    if (isIdentifierChar(C)) {
+      size_t WordEnd = Pos;
+      while (WordEnd < Code.size() && isIdentifierChar(Code[WordEnd]))
+        ++WordEnd;
+      // Leave the 'R' of a prefixed raw string to skipLiteralOrComment().
+      if (WordEnd < Code.size() && WordEnd - 1 > Pos && Code[WordEnd] == '"' &&
+          Code[WordEnd - 1] == 'R' && isRawStringPrefix(Code, WordEnd - 1)) {
+        Pos = WordEnd - 1;
+        continue;
+      }
+      StringRef Word = Code.slice(Pos, WordEnd);
+      if (Word == "namespace" && !AfterUsing)
+        PendingNamespace = true;
+      // Template parameters aside, these introduce a body ending in "};".
+      if ((Word == "struct" || Word == "class" || Word == "union" ||
+           Word == "enum") &&
+          LastSignificant != '<' && LastSignificant != ',')
+        DeclNeedsSemi = true;
+      AfterUsing = Word == "using";
+      Pos = WordEnd;
+      tokenEnd('a');
+      continue;
+    }
+    AfterUsing = false;
+
+    char Significant = C;
+    switch (C) {
+    case '{':
+      if (PendingNamespace && OtherBrackets == 0) {
+        Brackets.push_back(NextScope++);
+        DeclNeedsSemi = false;
+      } else {
+        if (OtherBrackets == 0)
+          BraceNeedsSemi = DeclNeedsSemi;
+        Brackets.push_back(0);
+        ++OtherBrackets;
+      }
+      PendingNamespace = false;
+      break;
+    case '(':
+    case '[':
+      Brackets.push_back(0);
+      ++OtherBrackets;
+      PendingNamespace = false;
+      break;
+    case ')':
+    case ']':
+    case '}':
+      if (Brackets.empty()) {
+        Unbalanced = true;
+        break;
+      }
+      if (Brackets.back() == 0)
+        --OtherBrackets;
+      Brackets.pop_back();
+      if (C == '}' && OtherBrackets == 0) {
+        // The body of a record or an initializer needs a ';' to end the
+        // declaration.
+        if (BraceNeedsSemi)
+          Significant = '{';
+        BraceNeedsSemi = DeclNeedsSemi = false;
+      }
+      break;
+    case ';':
+      if (OtherBrackets == 0)
+        DeclNeedsSemi = false;
+      PendingNamespace = false;
+      break;
+    case '=':
+      if (OtherBrackets == 0)
+        DeclNeedsSemi = true;
+      PendingNamespace = false;
+      break;
+    }
+    ++Pos;
+    tokenEnd(Significant);
+  }
+
+  std::vector<RegionBoundary> Boundaries;
+  if (Unbalanced || !Brackets.empty() || PPDepth != 0)
+    return Boundaries;
+
+  for (const Candidate &C : Candidates) {
+    if (C.PPDepth == 0 || (C.PPDepth == 1 && Guard == AfterGuard))
+      Boundaries.push_back(C.Boundary);
+  }
+  return Boundaries;
+}
+
+std::vector<CommentBlock> conformingComments(StringRef Code,
+                                             unsigned ColumnLimit) {
+  std::vector<CommentBlock> Blocks;
+  bool LineStart = true;
+
+  for (size_t Pos = 0; Pos < Code.size();) {
+    const char C = Code[Pos];
+    if (C == '\n') {
+      LineStart = true;
+      ++Pos;
+      continue;
+    }
+
+    if (LineStart) {
+      LineStart = false;
+      size_t First = Code.find_first_not_of(' ', Pos);
+      StringRef Indent = Code.slice(Pos, First);
+      CommentBlock Block = {static_cast<unsigned>(Pos), 0, 0};
+      for (size_t Line = Pos; Line < Code.size();) {
+        size_t End = skipTidyComment(Code, Line, Indent, ColumnLimit);
+        if (End == Line)
+          break;
+        Block.End = End;
+        Block.Lines += Code.slice(Line, End).count('\n') + 1;
+        Line = End + 1;
+      }
+      if (Block.Lines > 0) {
+        Blocks.push_back(Block);
+        Pos = Block.End;
+        continue;
+      }
+    }
+
+    if (isSpace(C)) {
+      ++Pos;
+      continue;
+    }
+    size_t End = skipLiteralOrComment(Code, Pos);
+    Pos = End == Pos ? Pos + 1 : End;
+  }
+  return Blocks;
+}
+
+std::vector<BracedList> largeBracedLists(StringRef Code, unsigned MinItems) {
+  std::vector<BracedList> Lists;
+  BracedList List;
+  bool LineStart = true;
+  char LastSignificant = 0;
+
+  for (size_t Pos = 0; Pos < Code.size();) {
+    const char C = Code[Pos];
+    if (C == '\n') {
+      LineStart = true;
+      ++Pos;
+      continue;
+    }
+    if (isSpace(C)) {
+      ++Pos;
+      continue;
+    }
+    if (C == '#' && LineStart) {
+      Pos = skipDirective(Code, Pos);
+      LastSignificant = '#';
+      continue;
+    }
+    LineStart = false;
+
+    size_t End = skipLiteralOrComment(Code, Pos);
+    if (End != Pos) {
+      if (C != '/')
+        LastSignificant = '"';
+      Pos = End;
+      continue;
+    }
+
+    if (isIdentifierChar(C)) {
+      size_t WordEnd = Pos;
+      while (WordEnd < Code.size() && isIdentifierChar(Code[WordEnd]))
+        ++WordEnd;
+      // Leave the 'R' of a prefixed raw string to skipLiteralOrComment().
+      if (WordEnd < Code.size() && WordEnd - 1 > Pos && Code[WordEnd] == '"' &&
+          Code[WordEnd - 1] == 'R' && isRawStringPrefix(Code, WordEnd - 1)) {
+        Pos = WordEnd - 1;
+        continue;
+      }
+      Pos = WordEnd;
+      LastSignificant = 'a';
+      continue;
+    }
+
+    // A list that turns out not to qualify is scanned again from its first
+    // item, which holds no brace, so each byte is looked at at most twice.
+    if (C == '{' && LastSignificant == '=' &&
+        parseBracedList(Code, Pos, List)) {
+      Pos = List.End + 1;
+      LastSignificant = '}';
+      if (List.Items.size() >= MinItems)
+        Lists.push_back(std::move(List));
+      continue;
+    }
+
+    LastSignificant = C;
+    ++Pos;
+  }
+
+  return Lists;
+}
+
+std::vector<MacroDefinition>
+parseMacroDefinitions(ArrayRef<std::string> Macros) {
+  std::vector<MacroDefinition> Definitions;
+  Definitions.reserve(Macros.size());
+  for (StringRef Macro : Macros) {
+    MacroDefinition &Definition = Definitions.emplace_back();
+    StringRef Text = Macro.ltrim();
+    if (!Text.empty() && isIdentifierChar(Text[0]) && !isDigit(Text[0])) {
+      StringRef Name = Text.take_while(isIdentifierChar);
+      Definition.Name = Name.str();
+      Text = Text.drop_front(Name.size());
+    }
+    forEachWord(Text, [&](StringRef Word) {
+      Definition.Identifiers.push_back(Word.str());
+    });
+  }
+  return Definitions;
+}
+
+std::vector<bool> usedMacros(ArrayRef<MacroDefinition> Definitions,
+                             StringRef Code) {
+  std::vector<bool> Used(Definitions.size());
+  SmallVector<unsigned> Expanded;
+  StringMap<SmallVector<unsigned, 1>> ByName;
+  for (unsigned I = 0; I < Definitions.size(); ++I) {
+    if (Definitions[I].Name.empty()) {
+      Used[I] = true;
+      Expanded.push_back(I);
+    } else {
+      ByName[Definitions[I].Name].push_back(I);
+    }
+  }
+
+  auto Use = [&](StringRef Word) {
+    auto It = ByName.find(Word);
+    if (It == ByName.end())
+      return;
+    for (unsigned I : It->second) {
+      if (!Used[I]) {
+        Used[I] = true;
+        Expanded.push_back(I);
+      }
+    }
+  };
+  forEachWord(Code, Use);
+  while (!Expanded.empty()) {
+    unsigned I = Expanded.pop_back_val();
+    for (StringRef Word : Definitions[I].Identifiers)
+      Use(Word);
+  }
+  return Used;
+}
+
+} // namespace format
+} // namespace clang
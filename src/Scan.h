@@ -0,0 +1,108 @@
+#ifndef CLANG_FORMAT_WASM_SCAN_H_
+#define CLANG_FORMAT_WASM_SCAN_H_
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace format {
+
+// Cheap structural scans of the input that run before clang-format lexes it.
+// They understand comments, string and character literals (including C++ raw
+// strings) well enough to ignore brackets inside them, but do not tokenize.
+
+// Returns the deepest nesting in `Code` of what clang-format recurses on:
+// (), [] and {}, control statements with unbraced bodies, "else if" chains and
+// angle brackets after a name.
+unsigned maxNestingDepth(llvm::StringRef Code);
+
+// Returns whether `Code` may contain Objective-C: '@', '^', a message send or
+// method declaration, a for-in loop or a Foundation name. Code without any of
+// these is never guessed to be Objective-C by clang::format::guessLanguage(),
+// which parses all of a .h file to find out.
+bool mayContainObjC(llvm::StringRef Code);
+
+// Returns the code to pass to guessLanguage() or getStyle() for `FileName`:
+// `Code`, or nothing when the guess would parse it only to find it is not
+// Objective-C and it has no "clang-format Language:" comment. The guessed
+// language is the same either way.
+llvm::StringRef codeForLanguageGuess(llvm::StringRef FileName,
+                                     llvm::StringRef Code);
+
+// A line start at which clang-format can start over as if at the start of a
+// file, see regionBoundaries().
+struct RegionBoundary {
+  unsigned Offset;
+  // Id of the innermost namespace body containing the line, 0 at file scope.
+  // Code between two boundaries with the same scope has balanced brackets.
+  unsigned Scope;
+  // Number of newlines between the previous token and the line, at least 2.
+  unsigned Newlines;
+  // Whether the line starts with code rather than a comment or a directive.
+  bool StartsWithCode;
+};
+
+// Returns the line starts of `Code` that follow a declaration ending in ';' or
+// '}' or a preprocessor directive, separated from it only by empty lines, and
+// that do not start with '}'. They are outside any brackets except namespace
+// braces and outside preprocessor conditionals except an include guard.
+// Returns nothing if the brackets of `Code` do not balance.
+std::vector<RegionBoundary> regionBoundaries(llvm::StringRef Code);
+
+// A run of lines holding nothing but comments, see conformingComments().
+struct CommentBlock {
+  // Offset of the start of the first line.
+  unsigned Begin;
+  // Offset of the newline ending the last line, or the size of the code.
+  unsigned End;
+  unsigned Lines;
+};
+
+// Returns the runs of comment lines of `Code` that clang-format keeps as they
+// are while their indentation does not change: consecutive lines with the
+// same indentation by spaces, no longer than `ColumnLimit` (0 for none) and
+// without trailing whitespace, holding line comments that start with "// ",
+// "/// " or "//! " or block comments whose lines start with an aligned '*'.
+std::vector<CommentBlock> conformingComments(llvm::StringRef Code,
+                                             unsigned ColumnLimit);
+
+// A braced list whose items are single literals or names, such as a table of
+// numbers or strings, see largeBracedLists().
+struct BracedList {
+  // Offsets of the braces.
+  unsigned Begin;
+  unsigned End;
+  // The items as written, each with its sign if it has one.
+  std::vector<llvm::StringRef> Items;
+};
+
+// Returns the lists of at least `MinItems` items initializing a variable after
+// '=' in `Code`, outside of preprocessor directives. Lists with a comment, a
+// nested bracket or a trailing comma are not returned.
+std::vector<BracedList> largeBracedLists(llvm::StringRef Code,
+                                         unsigned MinItems);
+
+// An entry of the `Macros` style option, such as "A(x)=x+1".
+struct MacroDefinition {
+  // The name of the macro, or empty if the entry does not start with one.
+  std::string Name;
+  // The words of the entry after the name that may be identifiers.
+  std::vector<std::string> Identifiers;
+};
+
+// Splits each of `Macros` into its name and identifiers.
+std::vector<MacroDefinition>
+parseMacroDefinitions(llvm::ArrayRef<std::string> Macros);
+
+// Returns for each of `Definitions` whether it may be expanded in `Code`: its
+// name is a word of `Code` or an identifier of another definition that may be
+// expanded. Definitions without a name always may.
+std::vector<bool> usedMacros(llvm::ArrayRef<MacroDefinition> Definitions,
+                             llvm::StringRef Code);
+
+} // namespace format
+} // namespace clang
+
+#endif // CLANG_FORMAT_WASM_SCAN_H_
@@ -13,14 +13,60 @@ EMSCRIPTEN_BINDINGS(my_module) {
       .field("status", &Result::status)
       .field("content", &Result::content);
 
+  value_object<Stats>("Stats")
+      .field("bytes", &Stats::bytes)
+      .field("tokens", &Stats::tokens)
+      .field("replacements", &Stats::replacements)
+      .field("include_replacements", &Stats::include_replacements)
+      .field("styles_resolved", &Stats::styles_resolved)
+      .field("style_ms", &Stats::style_ms)
+      .field("sort_includes_ms", &Stats::sort_includes_ms)
+      .field("reformat_ms", &Stats::reformat_ms)
+      .field("apply_ms", &Stats::apply_ms)
+      .field("heap_allocated_bytes", &Stats::heap_allocated_bytes)
+      .field("heap_allocations", &Stats::heap_allocations)
+      .field("heap_peak_bytes", &Stats::heap_peak_bytes)
+      .field("parse_passes", &Stats::parse_passes)
+      .field("unwrapped_lines", &Stats::unwrapped_lines)
+      .field("penalty_states", &Stats::penalty_states);
+
+  value_object<HeapStats>("HeapStats")
+      .field("allocated_bytes", &HeapStats::allocated_bytes)
+      .field("freed_bytes", &HeapStats::freed_bytes)
+      .field("allocations", &HeapStats::allocations)
+      .field("frees", &HeapStats::frees)
+      .field("current_bytes", &HeapStats::current_bytes)
+      .field("peak_bytes", &HeapStats::peak_bytes)
+      .field("memory_bytes", &HeapStats::memory_bytes);
+
+  register_vector<std::string>("StringList");
+  register_vector<Result>("ResultList");
+
   class_<ClangFormat>("ClangFormat")
       .constructor()
       .function("with_style", &ClangFormat::with_style, allow_raw_pointers())
       .function("with_fallback_style", &ClangFormat::with_fallback_style,
                 allow_raw_pointers())
+      .function("with_config", &ClangFormat::with_config, allow_raw_pointers())
+      .function("without_config", &ClangFormat::without_config,
+                allow_raw_pointers())
+      .function("with_ignore", &ClangFormat::with_ignore, allow_raw_pointers())
+      .function("without_ignore", &ClangFormat::without_ignore,
+                allow_raw_pointers())
+      .function("is_ignored", &ClangFormat::is_ignored)
+      .function("filter_ignored", &ClangFormat::filter_ignored)
+      .function("with_stats", &ClangFormat::with_stats, allow_raw_pointers())
+      .function("with_chunking", &ClangFormat::with_chunking,
+                allow_raw_pointers())
+      .function("last_stats", &ClangFormat::last_stats)
       .function("format", &ClangFormat::format)
       .function("format_range", &ClangFormat::format_range)
       .function("format_line", &ClangFormat::format_line)
+      .function("format_changed", &ClangFormat::format_changed)
+      .function("format_batch", &ClangFormat::format_batch)
+      .function("format_embedded", &ClangFormat::format_embedded)
+      .function("profile_lines", &ClangFormat::profile_lines)
+      .class_function("heap_stats", &ClangFormat::heap_stats)
       .class_function("version", &ClangFormat::version)
       .class_function("dump_config", &ClangFormat::dump_config);
 }
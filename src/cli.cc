@@ -12,7 +12,6 @@
 ///
 //===----------------------------------------------------------------------===//
 
-#include "clang/../../lib/Format/MatchFilePath.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Basic/FileManager.h"
@@ -20,6 +19,7 @@
 #include "clang/Basic/Version.h"
 #include "clang/Format/Format.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/Inclusions/HeaderIncludes.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -28,6 +28,9 @@
 #include <fstream>
 
 #include "CustomFileSystem.h"
+#include "Ignore.h"
+#include "Profile.h"
+#include "Scan.h"
 
 using namespace llvm;
 using clang::tooling::Replacements;
@@ -137,6 +140,13 @@ static cl::opt<bool>
     Verbose("verbose", cl::desc("If set, shows the list of processed files"),
             cl::cat(ClangFormatCategory));
 
+static cl::opt<unsigned> ProfileLines(
+    "profile-lines",
+    cl::desc("Print the <N> line ranges of each file that cost\n"
+             "the most to format to stderr, within the ranges\n"
+             "given by -lines, -offset and -length."),
+    cl::value_desc("N"), cl::init(0), cl::cat(ClangFormatCategory));
+
 // Use --dry-run to match other LLVM tools when you mean do it but don't
 // actually do it
 static cl::opt<bool>
@@ -446,16 +456,34 @@ static bool format(StringRef FileName, bool ErrorOnIncompleteFormat = false) {
     return true;
   }
 
-  auto RealFS = vfs::getRealFileSystem();
-  auto CustomFS = new vfs::CustomFileSystem(RealFS);
-  IntrusiveRefCntPtr<vfs::FileSystem> CustomFSPtr(CustomFS);
-  Expected<FormatStyle> FormatStyle =
-      getStyle(Style, AssumedFileName, FallbackStyle, Code->getBuffer(),
-               CustomFSPtr.get(), WNoErrorList.isSet(WNoError::Unknown));
-  if (!FormatStyle) {
-    llvm::errs() << toString(FormatStyle.takeError()) << "\n";
-    return true;
+  // Files in one directory share their configuration files, so the style is
+  // looked up once per directory and guessed language.
+  static StringMap<clang::format::FormatStyle> StyleCache;
+  StringRef CodeForGuess =
+      codeForLanguageGuess(AssumedFileName, Code->getBuffer());
+  FormatStyle::LanguageKind Language =
+      guessLanguage(AssumedFileName, CodeForGuess);
+  std::string StyleKey = (Twine(static_cast<unsigned>(Language)) + ":" +
+                          sys::path::parent_path(AssumedFileName))
+                             .str();
+  auto Cached = StyleCache.find(StyleKey);
+  if (Cached == StyleCache.end()) {
+    auto RealFS = vfs::getRealFileSystem();
+    auto CustomFS = new vfs::CustomFileSystem(RealFS);
+    IntrusiveRefCntPtr<vfs::FileSystem> CustomFSPtr(CustomFS);
+    Expected<clang::format::FormatStyle> NewStyle =
+        getStyle(Style, AssumedFileName, FallbackStyle, CodeForGuess,
+                 CustomFSPtr.get(), WNoErrorList.isSet(WNoError::Unknown));
+    if (!NewStyle) {
+      llvm::errs() << toString(NewStyle.takeError()) << "\n";
+      return true;
+    }
+    NewStyle->IncludeStyle.Compiled =
+        std::make_shared<const tooling::CompiledIncludeStyle>(
+            NewStyle->IncludeStyle);
+    Cached = StyleCache.try_emplace(StyleKey, std::move(*NewStyle)).first;
   }
+  std::optional<clang::format::FormatStyle> FormatStyle = Cached->second;
 
   StringRef QualifierAlignmentOrder = QualifierAlignment;
 
@@ -498,17 +526,35 @@ static bool format(StringRef FileName, bool ErrorOnIncompleteFormat = false) {
       llvm::errs() << "Bad Json variable insertion\n";
   }
 
-  auto ChangedCode = tooling::applyAllReplacements(Code->getBuffer(), Replaces);
-  if (!ChangedCode) {
-    llvm::errs() << toString(ChangedCode.takeError()) << "\n";
-    return true;
+  // Most inputs have their includes sorted already; formatting then works on
+  // the buffer itself instead of a copy with new ranges.
+  std::string SortedCode;
+  StringRef ChangedCode = Code->getBuffer();
+  if (!Replaces.empty()) {
+    auto NewCode = tooling::applyAllReplacements(Code->getBuffer(), Replaces);
+    if (!NewCode) {
+      llvm::errs() << toString(NewCode.takeError()) << "\n";
+      return true;
+    }
+    SortedCode = std::move(*NewCode);
+    ChangedCode = SortedCode;
+
+    // Get new affected ranges after sorting `#includes`.
+    Ranges = tooling::calculateRangesAfterReplacements(Replaces, Ranges);
   }
-  // Get new affected ranges after sorting `#includes`.
-  Ranges = tooling::calculateRangesAfterReplacements(Replaces, Ranges);
+  // Line costs are recorded while formatting the requested ranges.
+  std::optional<LineCostCollector> LineCosts;
+  if (ProfileLines)
+    LineCosts.emplace();
   FormattingAttemptStatus Status;
   Replacements FormatChanges =
-      reformat(*FormatStyle, *ChangedCode, Ranges, AssumedFileName, &Status);
+      reformat(*FormatStyle, ChangedCode, Ranges, AssumedFileName, &Status);
   Replaces = Replaces.merge(FormatChanges);
+  if (LineCosts) {
+    errs() << AssumedFileName << ":\n";
+    printLineCosts(errs(), LineCosts->hottest(ProfileLines));
+    LineCosts.reset();
+  }
   if (DryRun) {
     return Replaces.size() > (IsJson ? 1u : 0u) &&
            emitReplacementWarnings(Replaces, AssumedFileName, Code);
@@ -590,20 +636,12 @@ static int dumpConfig() {
 }
 
 using String = SmallString<128>;
-static String IgnoreDir;             // Directory of .clang-format-ignore file.
-static String PrevDir;               // Directory of previous `FilePath`.
-static SmallVector<String> Patterns; // Patterns in .clang-format-ignore file.
+static String PrevDir; // Directory of previous `FilePath`.
+static std::optional<clang::format::IgnoreFile>
+    Ignore; // Nearest .clang-format-ignore file of `PrevDir`.
 
 // Check whether `FilePath` is ignored according to the nearest
-// .clang-format-ignore file based on the rules below:
-// - A blank line is skipped.
-// - Leading and trailing spaces of a line are trimmed.
-// - A line starting with a hash (`#`) is a comment.
-// - A non-comment line is a single pattern.
-// - The slash (`/`) is used as the directory separator.
-// - A pattern is relative to the directory of the .clang-format-ignore file (or
-//   the root directory if the pattern starts with a slash).
-// - A pattern is negated if it starts with a bang (`!`).
+// .clang-format-ignore file, see IgnoreFile for the rules.
 static bool isIgnored(StringRef FilePath) {
   using namespace llvm::sys::fs;
   if (!is_regular_file(FilePath))
@@ -620,6 +658,7 @@ static bool isIgnored(StringRef FilePath) {
 
   if (StringRef Dir{parent_path(AbsPath, PathStyle)}; PrevDir != Dir) {
     PrevDir = Dir;
+    Ignore.reset();
 
     for (;;) {
       Path = Dir;
@@ -631,52 +670,14 @@ static bool isIgnored(StringRef FilePath) {
         return false;
     }
 
-    IgnoreDir = convert_to_slash(Dir, PathStyle);
-
-    std::ifstream IgnoreFile{Path.c_str()};
-    if (!IgnoreFile.good())
+    auto Content = MemoryBuffer::getFile(Path, /*IsText=*/true);
+    if (!Content)
       return false;
 
-    Patterns.clear();
-
-    for (std::string Line; std::getline(IgnoreFile, Line);) {
-      if (const auto Pattern{StringRef{Line}.trim()};
-          // Skip empty and comment lines.
-          !Pattern.empty() && Pattern[0] != '#') {
-        Patterns.push_back(Pattern);
-      }
-    }
+    Ignore.emplace(convert_to_slash(Dir, PathStyle), (*Content)->getBuffer());
   }
 
-  if (IgnoreDir.empty())
-    return false;
-
-  const auto Pathname{convert_to_slash(AbsPath, PathStyle)};
-  for (const auto &Pat : Patterns) {
-    const bool IsNegated = Pat[0] == '!';
-    StringRef Pattern{Pat};
-    if (IsNegated)
-      Pattern = Pattern.drop_front();
-
-    if (Pattern.empty())
-      continue;
-
-    Pattern = Pattern.ltrim();
-
-    // `Pattern` is relative to `IgnoreDir` unless it starts with a slash.
-    // This doesn't support patterns containing drive names (e.g. `C:`).
-    if (Pattern[0] != '/') {
-      Path = IgnoreDir;
-      append(Path, Style::posix, Pattern);
-      remove_dots(Path, /*remove_dot_dot=*/true, Style::posix);
-      Pattern = Path;
-    }
-
-    if (clang::format::matchFilePath(Pattern, Pathname) == !IsNegated)
-      return true;
-  }
-
-  return false;
+  return Ignore && Ignore->matches(convert_to_slash(AbsPath, PathStyle));
 }
 
 int main(int argc, const char **argv) {
@@ -13,15 +13,85 @@
 //===----------------------------------------------------------------------===//
 
 #include "lib.h"
+#include "Counters.h"
+#include "Heap.h"
+#include "Ignore.h"
+#include "LineDiff.h"
+#include "Profile.h"
+#include "Scan.h"
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/Version.h"
 #include "clang/Format/Format.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Tooling/Inclusions/HeaderIncludes.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Unicode.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#ifdef CLANG_FORMAT_WASM_THREADS
+#include "llvm/Support/Parallel.h"
+#endif
+
+// The unwrapped line parser and the formatter recurse once per nesting level.
+// Deeper input is rejected up front instead of trapping on the fixed wasm
+// stack; the limit is configured together with the stack size in CMake.
+#ifndef CLANG_FORMAT_WASM_MAX_NESTING_DEPTH
+#define CLANG_FORMAT_WASM_MAX_NESTING_DEPTH 512
+#endif
+
+#if defined(CLANG_FORMAT_WASM_THREADS) && !defined(CLANG_FORMAT_WASM_THREAD_POOL_SIZE)
+#define CLANG_FORMAT_WASM_THREAD_POOL_SIZE 4
+#endif
 
 using namespace llvm;
 using clang::tooling::Replacements;
 
+// A resolved style and what is derived from it once for all calls.
+struct CachedStyle {
+  // Its include style carries the compiled include regexes.
+  std::shared_ptr<const clang::format::FormatStyle> Style;
+  // The entries of its `Macros` option.
+  std::vector<clang::format::MacroDefinition> Macros;
+};
+
+// Configuration and caches of a ClangFormat instance, guarded by `Mutex`.
+//
+// Resolved styles are keyed by directory and language. Without a file system
+// the options never depend on the file name beyond the language guessed from
+// it and the code, and on the directory only through registered config files;
+// the directory is empty when none are used. Entries are shared so that a call
+// still using a style is not affected by another thread changing the style.
+struct FormatterState {
+  std::mutex Mutex;
+  std::string Style = clang::format::DefaultFormatStyle;
+  std::string FallbackStyle = clang::format::DefaultFallbackStyle;
+  std::map<std::pair<std::string, clang::format::FormatStyle::LanguageKind>,
+           std::shared_ptr<const CachedStyle>>
+      Styles;
+
+  // `.clang-format` contents registered by absolute directory, searched like
+  // on a real file system when the style is "file". `ConfigFS` holds them and
+  // is rebuilt on first use after a change.
+  std::map<std::string, std::string> Configs;
+  IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> ConfigFS;
+
+  // `.clang-format-ignore` contents registered by directory.
+  clang::format::IgnoreMatcher Ignores;
+
+  bool CollectStats = false;
+  Stats LastStats{};
+
+  // Whether large files are formatted in chunks, see reformatRegions().
+  bool FormatInChunks = false;
+};
+
 namespace clang {
 namespace format {
 
@@ -46,26 +116,210 @@ static auto isPredefinedStyle(StringRef style) -> bool {
       .Default(false);
 }
 
-static auto format_range(const std::unique_ptr<llvm::MemoryBuffer> code,
-                         const std::string assumedFileName,
-                         const std::string style,
-                         const std::string fallback_style,
-                         std::vector<tooling::Range> ranges) -> Result {
-  StringRef BufStr = code->getBuffer();
+// Runs `Fn` for every index in [0, Count). The multithreaded build spreads the
+// calls over the LLVM thread pool, other builds run them in order. The pool is
+// limited to the workers Emscripten starts with the module, the LLVM default
+// of one thread per core would wait forever for the missing ones.
+template <typename Function>
+static auto forEachIndex(size_t Count, Function &&Fn) -> void {
+#ifdef CLANG_FORMAT_WASM_THREADS
+  static const bool PoolSized = [] {
+    llvm::parallel::strategy =
+        llvm::hardware_concurrency(CLANG_FORMAT_WASM_THREAD_POOL_SIZE);
+    return true;
+  }();
+  (void)PoolSized;
+  llvm::parallelFor(0, Count, Fn);
+#else
+  for (size_t Index = 0; Index < Count; ++Index)
+    Fn(Index);
+#endif
+}
 
-  const char *InvalidBOM = SrcMgr::ContentCache::getInvalidBOM(BufStr);
+// Measures consecutive phases of a call into the fields of a Stats object.
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Stats *CallStats)
+      : CallStats(CallStats), Last(std::chrono::steady_clock::now()) {}
 
-  if (InvalidBOM) {
-    std::stringstream err;
-    err << "encoding with unsupported byte order mark \"" << InvalidBOM
-        << "\" detected.";
+  // Adds the time since the previous phase ended to `Field`.
+  void lap(double Stats::*Field) {
+    auto Now = std::chrono::steady_clock::now();
+    if (CallStats)
+      CallStats->*Field +=
+          std::chrono::duration<double, std::milli>(Now - Last).count();
+    Last = Now;
+  }
 
-    return Result::error(err.str());
+private:
+  Stats *CallStats;
+  std::chrono::steady_clock::time_point Last;
+};
+
+static auto addStats(Stats &Total, const Stats &CallStats) -> void {
+  Total.bytes += CallStats.bytes;
+  Total.tokens += CallStats.tokens;
+  Total.replacements += CallStats.replacements;
+  Total.include_replacements += CallStats.include_replacements;
+  Total.styles_resolved += CallStats.styles_resolved;
+  Total.style_ms += CallStats.style_ms;
+  Total.sort_includes_ms += CallStats.sort_includes_ms;
+  Total.reformat_ms += CallStats.reformat_ms;
+  Total.apply_ms += CallStats.apply_ms;
+  Total.heap_allocated_bytes += CallStats.heap_allocated_bytes;
+  Total.heap_allocations += CallStats.heap_allocations;
+  Total.heap_peak_bytes =
+      std::max(Total.heap_peak_bytes, CallStats.heap_peak_bytes);
+  Total.parse_passes += CallStats.parse_passes;
+  Total.unwrapped_lines += CallStats.unwrapped_lines;
+  Total.penalty_states += CallStats.penalty_states;
+}
+
+// Runs `Fn` with the Stats object to fill, or null if the instance does not
+// collect stats, and records the filled object as the stats of the last call.
+template <typename Function>
+static auto withStats(FormatterState &State, Function &&Fn)
+    -> decltype(Fn(nullptr)) {
+  bool Collect;
+  {
+    std::lock_guard<std::mutex> Lock(State.Mutex);
+    Collect = State.CollectStats;
   }
+  if (!Collect)
+    return Fn(nullptr);
 
-  StringRef AssumedFileName = assumedFileName;
-  if (AssumedFileName.empty())
-    AssumedFileName = "<stdin>";
+  Stats CallStats{};
+  const HeapStats HeapBefore = heapStats();
+  const unsigned long long LiveBefore = resetHeapWatermark();
+
+  auto Value = Fn(&CallStats);
+
+  const HeapStats HeapAfter = heapStats();
+  CallStats.heap_allocated_bytes =
+      HeapAfter.allocated_bytes - HeapBefore.allocated_bytes;
+  CallStats.heap_allocations = HeapAfter.allocations - HeapBefore.allocations;
+  // Concurrent calls share the watermark, so their peaks may overlap.
+  CallStats.heap_peak_bytes =
+      double(std::max(heapWatermark(), LiveBefore) - LiveBefore);
+
+  std::lock_guard<std::mutex> Lock(State.Mutex);
+  State.LastStats = CallStats;
+  return Value;
+}
+
+// Counts the tokens of `Code` with a raw lexer in the style's language mode.
+static auto countTokens(const FormatStyle &Style, StringRef Code) -> unsigned {
+  LangOptions LangOpts = getFormattingLangOpts(Style);
+  Lexer Lex(SourceLocation(), LangOpts, Code.begin(), Code.begin(), Code.end());
+  Lex.SetCommentRetentionState(true);
+
+  unsigned Count = 0;
+  for (Token Tok;;) {
+    Lex.LexFromRawLexer(Tok);
+    if (Tok.is(tok::eof))
+      break;
+    ++Count;
+  }
+  return Count;
+}
+
+static constexpr auto PosixStyle = llvm::sys::path::Style::posix;
+
+// Returns `Path` as an absolute path of the config file system.
+static auto configPath(StringRef Path) -> std::string {
+  SmallString<128> Absolute("/");
+  llvm::sys::path::append(Absolute, PosixStyle, Path);
+  llvm::sys::path::remove_dots(Absolute, /*remove_dot_dot=*/true, PosixStyle);
+  return std::string(Absolute);
+}
+
+// Returns the file system with the registered config files, building it if
+// they changed since it was last used. Expects `State.Mutex` to be held.
+static auto getConfigFS(FormatterState &State)
+    -> IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> {
+  if (State.ConfigFS)
+    return State.ConfigFS;
+
+  IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> FS(
+      new llvm::vfs::InMemoryFileSystem);
+  FS->setCurrentWorkingDirectory("/");
+  for (const auto &[Directory, Config] : State.Configs) {
+    SmallString<128> Path(Directory);
+    llvm::sys::path::append(Path, PosixStyle, ".clang-format");
+    FS->addFile(Path, 0, MemoryBuffer::getMemBufferCopy(Config, Path));
+  }
+  State.ConfigFS = FS;
+  return FS;
+}
+
+// Registers or, if `Config` is null, removes the config of `Directory`, and
+// drops the styles resolved for it and its subdirectories.
+static auto setConfig(FormatterState &State, StringRef Directory,
+                      const std::string *Config) -> void {
+  std::string Path = configPath(Directory);
+  std::lock_guard<std::mutex> Lock(State.Mutex);
+
+  if (Config)
+    State.Configs[Path] = *Config;
+  else
+    State.Configs.erase(Path);
+  State.ConfigFS = nullptr;
+
+  for (auto It = State.Styles.begin(); It != State.Styles.end();) {
+    StringRef StyleDirectory = It->first.first;
+    bool Affected = StyleDirectory.empty() || Path == "/" ||
+                    StyleDirectory == Path ||
+                    StyleDirectory.starts_with(Path + "/");
+    It = Affected ? State.Styles.erase(It) : std::next(It);
+  }
+}
+
+static auto getCachedStyle(FormatterState &State, StringRef AssumedFileName,
+                           StringRef Code, Stats *CallStats)
+    -> Expected<std::shared_ptr<const CachedStyle>> {
+  PhaseTimer Timer(CallStats);
+  auto Lap = llvm::make_scope_exit([&] { Timer.lap(&Stats::style_ms); });
+
+  // Only headers that may be Objective-C need to be parsed to guess.
+  Code = codeForLanguageGuess(AssumedFileName, Code);
+  const FormatStyle::LanguageKind Language =
+      guessLanguage(AssumedFileName, Code);
+
+  std::lock_guard<std::mutex> Lock(State.Mutex);
+
+  const bool UseConfigs = !State.Configs.empty() &&
+                          StringRef(State.Style).equals_insensitive("file");
+  const std::string FilePath = UseConfigs ? configPath(AssumedFileName) : "";
+  auto Key = std::make_pair(
+      std::string(llvm::sys::path::parent_path(FilePath, PosixStyle)),
+      Language);
+
+  auto Cached = State.Styles.find(Key);
+  if (Cached != State.Styles.end())
+    return Cached->second;
+
+  auto Cache = [&](format::FormatStyle Resolved) {
+    auto Shared = std::make_shared<CachedStyle>();
+    Shared->Macros = parseMacroDefinitions(Resolved.Macros);
+    Resolved.IncludeStyle.Compiled =
+        std::make_shared<const tooling::CompiledIncludeStyle>(
+            Resolved.IncludeStyle);
+    Shared->Style =
+        std::make_shared<const format::FormatStyle>(std::move(Resolved));
+    State.Styles[Key] = Shared;
+    if (CallStats)
+      ++CallStats->styles_resolved;
+    return std::shared_ptr<const CachedStyle>(std::move(Shared));
+  };
+
+  if (UseConfigs) {
+    llvm::Expected<format::FormatStyle> FormatStyle =
+        format::getStyle("file", FilePath, State.FallbackStyle, Code,
+                         getConfigFS(State).get(), false);
+    if (!FormatStyle)
+      return FormatStyle.takeError();
+    return Cache(std::move(*FormatStyle));
+  }
 
   IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
       new llvm::vfs::InMemoryFileSystem);
@@ -76,11 +330,11 @@ static auto format_range(const std::unique_ptr<llvm::MemoryBuffer> code,
       IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs), DiagOpts);
   SourceManager Sources(Diagnostics, Files);
 
-  StringRef _style = style;
+  StringRef _style = State.Style;
+  std::unique_ptr<llvm::MemoryBuffer> DotClangFormat;
 
   if (!_style.starts_with("{") && !isPredefinedStyle(_style)) {
-    std::unique_ptr<llvm::MemoryBuffer> DotClangFormat =
-        MemoryBuffer::getMemBuffer(style);
+    DotClangFormat = MemoryBuffer::getMemBuffer(State.Style);
 
     createInMemoryFile(".clang-format", *DotClangFormat.get(), Sources, Files,
                        InMemoryFileSystem.get());
@@ -88,68 +342,723 @@ static auto format_range(const std::unique_ptr<llvm::MemoryBuffer> code,
   }
 
   llvm::Expected<format::FormatStyle> FormatStyle =
-      format::getStyle(_style, AssumedFileName, fallback_style,
-                       code->getBuffer(), InMemoryFileSystem.get(), false);
+      format::getStyle(_style, AssumedFileName, State.FallbackStyle, Code,
+                       InMemoryFileSystem.get(), false);
 
   InMemoryFileSystem.reset();
 
-  if (!FormatStyle) {
-    std::string err = llvm::toString(FormatStyle.takeError());
-    return Result::error(err);
+  if (!FormatStyle)
+    return FormatStyle.takeError();
+  return Cache(std::move(*FormatStyle));
+}
+
+// Returns the style of `Cached` to format `Code` with. clang-format lexes and
+// parses each definition of the `Macros` option again in every pass over the
+// code, so those that `Code` cannot expand are left out.
+static auto styleForCode(const CachedStyle &Cached, StringRef Code)
+    -> std::shared_ptr<const FormatStyle> {
+  if (Cached.Macros.empty())
+    return Cached.Style;
+
+  std::vector<bool> Used = usedMacros(Cached.Macros, Code);
+  if (llvm::all_of(Used, [](bool U) { return U; }))
+    return Cached.Style;
+
+  auto Style = std::make_shared<FormatStyle>(*Cached.Style);
+  Style->Macros.clear();
+  for (size_t I = 0; I < Used.size(); ++I) {
+    if (Used[I])
+      Style->Macros.push_back(Cached.Style->Macros[I]);
+  }
+  return Style;
+}
+
+// Returns why `Code` is too deeply nested to format, or an empty string.
+static auto checkNestingDepth(StringRef Code) -> std::string {
+  const unsigned Depth = maxNestingDepth(Code);
+  if (Depth <= CLANG_FORMAT_WASM_MAX_NESTING_DEPTH)
+    return "";
+
+  std::stringstream err;
+  err << "nesting depth " << Depth << " exceeds the supported maximum of "
+      << CLANG_FORMAT_WASM_MAX_NESTING_DEPTH;
+  return err.str();
+}
+
+// Returns whether formatting `Code` can be split at region boundaries, that
+// is whether no option of `Style` looks across empty lines or derives a
+// setting from the whole file.
+static auto canFormatInRegions(const FormatStyle &Style, StringRef Code)
+    -> bool {
+  auto AcrossEmptyLines = [](const auto &Alignment) {
+    return Alignment.Enabled && Alignment.AcrossEmptyLines;
+  };
+
+  return Style.Language == FormatStyle::LK_Cpp && !Style.DisableFormat &&
+         !Style.DerivePointerAlignment &&
+         Style.Standard != FormatStyle::LS_Auto &&
+         Style.IndentPPDirectives == FormatStyle::PPDIS_None &&
+         Style.SeparateDefinitionBlocks == FormatStyle::SDS_Leave &&
+         Style.MacroBlockBegin.empty() && Style.MacroBlockEnd.empty() &&
+         !Style.ExperimentalAutoDetectBinPacking &&
+         Style.AlignTrailingComments.OverEmptyLines == 0 &&
+         !AcrossEmptyLines(Style.AlignConsecutiveAssignments) &&
+         !AcrossEmptyLines(Style.AlignConsecutiveBitFields) &&
+         !AcrossEmptyLines(Style.AlignConsecutiveDeclarations) &&
+         !AcrossEmptyLines(Style.AlignConsecutiveMacros) &&
+         !AcrossEmptyLines(Style.AlignConsecutiveShortCaseStatements) &&
+         !Code.contains('\r') && !Code.contains("clang-format off");
+}
+
+namespace {
+struct Region {
+  unsigned Begin;
+  unsigned End;
+};
+} // namespace
+
+// Returns the smallest region between `Boundaries` containing [Begin, End]
+// that formats like the whole of `Code`. It starts at a line of code whose
+// declaration no range touches, so that the indentation it tracks is the same,
+// and ends at a boundary of the same scope after `End`.
+static auto findRegion(ArrayRef<RegionBoundary> Boundaries,
+                       ArrayRef<tooling::Range> Ranges, unsigned CodeSize,
+                       unsigned Begin, unsigned End) -> Region {
+  auto Touched = [&](unsigned From, unsigned To) {
+    return llvm::any_of(Ranges, [&](const tooling::Range &R) {
+      return R.getOffset() <= To && R.getOffset() + R.getLength() >= From;
+    });
+  };
+
+  auto Start = llvm::partition_point(
+      Boundaries, [&](const RegionBoundary &B) { return B.Offset <= Begin; });
+  while (Start != Boundaries.begin()) {
+    --Start;
+    unsigned Next = Start + 1 == Boundaries.end() ? CodeSize : Start[1].Offset;
+    if (!Start->StartsWithCode || Touched(Start->Offset, Next))
+      continue;
+
+    auto Stop = std::find_if(Start + 1, Boundaries.end(),
+                             [&](const RegionBoundary &B) {
+                               return B.Offset > End && B.Scope == Start->Scope;
+                             });
+    if (Stop != Boundaries.end())
+      return {Start->Offset, Stop->Offset};
+    if (Start->Scope == 0)
+      return {Start->Offset, CodeSize};
+  }
+  return {0, CodeSize};
+}
+
+// Formats `Code` like format::reformat(). When `Ranges` cover all of it, the
+// largest blocks of comment lines that already conform to the style are left
+// out of them: clang-format then keeps those lines as they are, without
+// measuring and splitting them again, unless it changes their indentation.
+// It only fixes the indentation of lines out of range after a formatted line
+// that does not start with '}', so blocks at the start of the file or after
+// such a line stay in range.
+static auto reformatSkippingComments(const FormatStyle &Style, StringRef Code,
+                                     ArrayRef<tooling::Range> Ranges,
+                                     StringRef FileName,
+                                     FormattingAttemptStatus *Status)
+    -> tooling::Replacements {
+  // Each range costs a comparison per token when clang-format looks for the
+  // affected lines, so only a few large blocks are worth leaving out.
+  constexpr unsigned MinLines = 4;
+  constexpr size_t MaxBlocks = 64;
+
+  const bool SlashComments =
+      Style.isCpp() || Style.isJavaScript() ||
+      Style.Language == FormatStyle::LK_Java ||
+      Style.Language == FormatStyle::LK_CSharp;
+  if (Ranges.size() != 1 || Ranges[0].getOffset() != 0 ||
+      Ranges[0].getLength() != Code.size() || !SlashComments ||
+      Style.DisableFormat || Style.UseTab != FormatStyle::UT_Never ||
+      Style.SpacesInLineCommentPrefix.Minimum != 1 ||
+      Style.SpacesInLineCommentPrefix.Maximum != UINT_MAX) {
+    return reformat(Style, Code, Ranges, FileName, Status);
+  }
+
+  std::vector<CommentBlock> Blocks =
+      conformingComments(Code, Style.ColumnLimit);
+  llvm::erase_if(Blocks, [&](const CommentBlock &B) {
+    if (B.Lines < MinLines)
+      return true;
+    StringRef Before = Code.take_front(B.Begin).rtrim();
+    StringRef PreviousLine = Before.substr(Before.rfind('\n') + 1).ltrim();
+    return Before.empty() || PreviousLine.starts_with("}");
+  });
+  if (Blocks.size() > MaxBlocks) {
+    std::nth_element(Blocks.begin(), Blocks.begin() + MaxBlocks, Blocks.end(),
+                     [](const CommentBlock &A, const CommentBlock &B) {
+                       return A.End - A.Begin > B.End - B.Begin;
+                     });
+    Blocks.resize(MaxBlocks);
+    llvm::sort(Blocks, [](const CommentBlock &A, const CommentBlock &B) {
+      return A.Begin < B.Begin;
+    });
   }
 
+  // Ranges include their ends, so they stop before the newline preceding a
+  // block and start after the one ending it. The whitespace before a block
+  // stays in range for empty lines to be kept as the style says.
+  std::vector<tooling::Range> Kept;
+  unsigned Begin = 0;
+  for (const CommentBlock &B : Blocks) {
+    if (B.Begin > Begin)
+      Kept.emplace_back(Begin, B.Begin - 1 - Begin);
+    Begin = B.End + 1;
+  }
+  if (Begin < Code.size())
+    Kept.emplace_back(Begin, Code.size() - Begin);
+  return reformat(Style, Code, Kept, FileName, Status);
+}
+
+// Returns regions of at least `Bytes` that together cover `Code` of
+// `CodeSize` bytes and each format like it. They are split at the top level,
+// before a line of code, which clang-format indents the same when it formats
+// all of the code.
+static auto chunkRegions(ArrayRef<RegionBoundary> Boundaries,
+                         unsigned CodeSize, unsigned Bytes)
+    -> std::vector<Region> {
+  std::vector<Region> Regions;
+  unsigned Begin = 0;
+  for (const RegionBoundary &B : Boundaries) {
+    if (B.Scope != 0 || !B.StartsWithCode || B.Offset - Begin < Bytes ||
+        CodeSize - B.Offset < Bytes)
+      continue;
+    Regions.push_back({Begin, B.Offset});
+    Begin = B.Offset;
+  }
+  Regions.push_back({Begin, CodeSize});
+  return Regions;
+}
+
+// Formats `Code` like format::reformat(), but only lexes and annotates the
+// regions around `Ranges` when their declarations are separated from the rest
+// of the file by empty lines, so that formatting a few lines of a large file
+// costs about as much as formatting those lines alone. With `FormatInChunks`,
+// when the ranges cover most of a large file, it is formatted in chunks of
+// such declarations, so that the tokens and lines clang-format builds only
+// ever describe one chunk.
+static auto reformatRegions(const FormatStyle &Style, StringRef Code,
+                            std::vector<tooling::Range> Ranges,
+                            StringRef FileName, bool FormatInChunks,
+                            FormattingAttemptStatus *Status)
+    -> tooling::Replacements {
+  constexpr unsigned ChunkBytes = 64 * 1024;
+
+  unsigned RangeBytes = 0;
+  for (const tooling::Range &R : Ranges)
+    RangeBytes += R.getLength();
+  const bool Chunked = FormatInChunks && RangeBytes > Code.size() / 2;
+  if ((Chunked && Code.size() < 2 * ChunkBytes) ||
+      !canFormatInRegions(Style, Code))
+    return reformatSkippingComments(Style, Code, Ranges, FileName, Status);
+
+  std::vector<RegionBoundary> Boundaries = regionBoundaries(Code);
+  // An empty line in the gap is only kept if the style keeps that many, and
+  // namespace bodies are only formatted alike when they are not indented.
+  llvm::erase_if(Boundaries, [&](const RegionBoundary &B) {
+    return B.Newlines > Style.MaxEmptyLinesToKeep + 1 ||
+           (B.Scope != 0 &&
+            Style.NamespaceIndentation != FormatStyle::NI_None);
+  });
+
+  llvm::sort(Ranges, [](const tooling::Range &A, const tooling::Range &B) {
+    return A.getOffset() < B.getOffset();
+  });
+
+  std::vector<Region> Regions;
+  if (Chunked) {
+    Regions = chunkRegions(Boundaries, Code.size(), ChunkBytes);
+    if (Regions.size() == 1)
+      return reformatSkippingComments(Style, Code, Ranges, FileName, Status);
+  } else {
+    // Regions and the span of the ranges each one was found for.
+    std::vector<Region> Spans;
+    unsigned RegionBytes = 0;
+    for (const tooling::Range &R : Ranges) {
+      Region Span = {R.getOffset(), R.getOffset() + R.getLength()};
+      Region Found = findRegion(Boundaries, Ranges, Code.size(), Span.Begin,
+                                Span.End);
+      while (!Regions.empty() && Found.Begin < Regions.back().End) {
+        Span = {Spans.back().Begin, std::max(Span.End, Spans.back().End)};
+        RegionBytes -= Regions.back().End - Regions.back().Begin;
+        Regions.pop_back();
+        Spans.pop_back();
+        Found = findRegion(Boundaries, Ranges, Code.size(), Span.Begin,
+                           Span.End);
+      }
+      Regions.push_back(Found);
+      Spans.push_back(Span);
+      RegionBytes += Found.End - Found.Begin;
+    }
+    if (RegionBytes > Code.size() / 2)
+      return reformatSkippingComments(Style, Code, Ranges, FileName, Status);
+  }
+
+  // Regions are formatted in parallel and their replacements merged in order
+  // afterwards. The work counters are per thread, so each region's work is
+  // taken off the thread that did it and added to this one.
+  struct RegionResult {
+    std::vector<tooling::Replacement> Replaces;
+    FormattingAttemptStatus Status;
+    unsigned long long ParsePasses = 0;
+    unsigned long long UnwrappedLines = 0;
+    unsigned long long PenaltyStates = 0;
+  };
+  std::vector<RegionResult> Results(Regions.size());
+  forEachIndex(Regions.size(), [&](size_t Index) {
+    const Region &Region = Regions[Index];
+    RegionResult &Result = Results[Index];
+    StringRef Text = Code.slice(Region.Begin, Region.End);
+    std::vector<tooling::Range> RegionRanges;
+    for (const tooling::Range &R : Ranges) {
+      unsigned From = std::max(R.getOffset(), Region.Begin);
+      unsigned To = std::min(R.getOffset() + R.getLength(), Region.End);
+      if (From > To || (From == To && R.getLength() != 0) ||
+          (From == Region.End && Region.End != Code.size()))
+        continue;
+      RegionRanges.emplace_back(From - Region.Begin, To - From);
+    }
+
+    // The empty lines ending a region belong to the next one, which keeps
+    // them as they are. Whitespace reaching into them from the last line is
+    // cut there, keeping its line breaks, as the boundary keeps them all.
+    unsigned Tail = Region.End == Code.size()
+                        ? Text.size()
+                        : Text.rtrim('\n').size();
+
+    const unsigned long long PassesBefore = parsePassCount();
+    const unsigned long long LinesBefore = unwrappedLineCount();
+    const unsigned long long StatesBefore = penaltyStateCount();
+    tooling::Replacements Formatted = reformatSkippingComments(
+        Style, Text, RegionRanges, FileName, &Result.Status);
+    Result.ParsePasses = parsePassCount() - PassesBefore;
+    Result.UnwrappedLines = unwrappedLineCount() - LinesBefore;
+    Result.PenaltyStates = penaltyStateCount() - StatesBefore;
+    parsePassCount() = PassesBefore;
+    unwrappedLineCount() = LinesBefore;
+    penaltyStateCount() = StatesBefore;
+
+    for (const tooling::Replacement &R : Formatted) {
+      if (R.getOffset() >= Tail)
+        continue;
+      unsigned Length = R.getLength();
+      std::string Replacement = R.getReplacementText().str();
+      StringRef Cut = Text.slice(R.getOffset(), Tail);
+      if (R.getOffset() + Length > Tail && Cut.trim().empty()) {
+        Length = Cut.size();
+        Replacement.assign(Cut.count('\n'), '\n');
+        if (Replacement == Cut)
+          continue;
+      }
+      Result.Replaces.emplace_back(FileName, Region.Begin + R.getOffset(),
+                                   Length, Replacement);
+    }
+  });
+
+  tooling::Replacements Replaces;
+  for (size_t Index = 0; Index < Regions.size(); ++Index) {
+    const RegionResult &Result = Results[Index];
+    parsePassCount() += Result.ParsePasses;
+    unwrappedLineCount() += Result.UnwrappedLines;
+    penaltyStateCount() += Result.PenaltyStates;
+  }
+  for (size_t Index = 0; Index < Regions.size(); ++Index) {
+    const RegionResult &Result = Results[Index];
+    for (const tooling::Replacement &R : Result.Replaces) {
+      if (auto Err = Replaces.add(R)) {
+        llvm::consumeError(std::move(Err));
+        return reformatSkippingComments(Style, Code, Ranges, FileName, Status);
+      }
+    }
+
+    if (Status && !Result.Status.FormatComplete && Status->FormatComplete) {
+      Status->FormatComplete = false;
+      Status->Line = Code.take_front(Regions[Index].Begin).count('\n') +
+                     Result.Status.Line;
+    }
+  }
+  return Replaces;
+}
+
+// The columns of a braced list layout and the lines it takes.
+struct ListColumns {
+  std::vector<unsigned> Sizes;
+  unsigned Lines = 0;
+  bool Fits = false;
+};
+
+// Picks the columns clang-format lays out a long braced list in when its items
+// start `Available` columns before the column limit: the most columns that
+// fit, or fewer as long as that takes no more lines, skipping layouts wider
+// than the column limit or where an item is more than 10 columns narrower
+// than its column, but the last. One column is taken if nothing else fits.
+// `Lengths` are the widths of the items with their commas, and the last item
+// is `EndOfLineLength` wide when it ends a row, as the `};` stays on its line.
+static auto chooseColumns(const FormatStyle &Style, ArrayRef<unsigned> Lengths,
+                          unsigned EndOfLineLength, unsigned Available)
+    -> ListColumns {
+  ListColumns Best;
+  std::vector<unsigned> Sizes;
+  std::vector<unsigned> MinSizes;
+  const unsigned MaxColumns =
+      std::min<unsigned>(Style.ColumnLimit / 3, Lengths.size());
+  for (unsigned Count = MaxColumns; Count > 0; --Count) {
+    Sizes.assign(Count, 0);
+    MinSizes.assign(Count, UINT_MAX);
+    for (size_t I = 0; I < Lengths.size(); ++I) {
+      const unsigned Column = I % Count;
+      const unsigned Length = I + 1 == Lengths.size() && Column + 1 == Count
+                                  ? EndOfLineLength
+                                  : Lengths[I];
+      Sizes[Column] = std::max(Sizes[Column], Length);
+      MinSizes[Column] = std::min(MinSizes[Column], Length);
+    }
+    unsigned TotalWidth = Count - 1;
+    bool Uneven = false;
+    for (unsigned I = 0; I < Count; ++I) {
+      TotalWidth += Sizes[I];
+      Uneven |= I + 1 < Count && Sizes[I] - MinSizes[I] > 10;
+    }
+    if (Count > 1 &&
+        (Uneven || TotalWidth > Style.ColumnLimit || TotalWidth > Available))
+      continue;
+
+    const unsigned Lines = (Lengths.size() + Count - 1) / Count;
+    if (!Best.Sizes.empty() && Lines > Best.Lines)
+      break;
+    Best = {Sizes, Lines, TotalWidth <= Available};
+  }
+  return Best;
+}
+
+// Lays out `Items` into `Text`, the code between the braces of a list whose
+// brace is at `BraceColumn` on a line indented by `LineIndent` and followed by
+// `;`. clang-format keeps the items after the brace, or breaks after it and
+// indents them on the next lines when that saves enough lines to outweigh the
+// break. Returns false where the choice is not certain without its penalties,
+// where the items do not fit, and where they would take one column, which
+// clang-format bin-packs instead.
+static auto layoutList(const FormatStyle &Style, ArrayRef<StringRef> Items,
+                       unsigned BraceColumn, unsigned LineIndent,
+                       std::string &Text) -> bool {
+  if (!Style.BinPackArguments && !Style.BinPackLongBracedList)
+    return false;
+
+  // Widths of the items with their commas, as clang-format measures them.
+  std::vector<unsigned> Lengths;
+  Lengths.reserve(Items.size());
+  for (StringRef Item : Items) {
+    int Width = llvm::sys::unicode::columnWidthUTF8(Item);
+    if (Width < 0)
+      return false;
+    Lengths.push_back(Width + 1);
+  }
+  --Lengths.back();
+  const unsigned EndOfLineLength = Lengths.back() + 2;
+  const unsigned BraceIndent = BraceColumn + 1;
+  const unsigned BreakIndent =
+      LineIndent + Style.BracedInitializerIndentWidth.value_or(
+                       Style.ContinuationIndentWidth);
+  if (std::max(BraceIndent, BreakIndent) >= Style.ColumnLimit)
+    return false;
+
+  unsigned OneLine = Items.size() - 1 + 2;
+  for (unsigned Length : Lengths)
+    OneLine += Length;
+  if (BraceIndent + OneLine <= Style.ColumnLimit) {
+    Text = llvm::join(Items, ", ");
+    return true;
+  }
+
+  ListColumns AfterBrace = chooseColumns(Style, Lengths, EndOfLineLength,
+                                         Style.ColumnLimit - BraceIndent);
+  ListColumns AfterBreak = chooseColumns(Style, Lengths, EndOfLineLength,
+                                         Style.ColumnLimit - BreakIndent);
+  if (!AfterBrace.Fits)
+    return false;
+
+  // Breaking after the brace is a break of its own, which also costs the
+  // penalty for breaking before a first argument. Saving one line makes up for
+  // it only if that penalty is 0, and saving two does up to the default of 19.
+  const unsigned Saved = AfterBrace.Lines > AfterBreak.Lines
+                             ? AfterBrace.Lines - AfterBreak.Lines
+                             : 0;
+  bool Break = false;
+  if (Saved >= 2 && Style.PenaltyBreakBeforeFirstCallParameter <= 19)
+    Break = true;
+  else if (Saved > 1 ||
+           (Saved == 1 && Style.PenaltyBreakBeforeFirstCallParameter == 0))
+    return false;
+
+  const ListColumns &Columns = Break ? AfterBreak : AfterBrace;
+  const unsigned Indent = Break ? BreakIndent : BraceIndent;
+  const unsigned Count = Columns.Sizes.size();
+  if (Count == 1 || !Columns.Fits)
+    return false;
+
+  Text.clear();
+  for (size_t I = 0; I < Items.size(); ++I) {
+    if (I % Count == 0 && (I > 0 || Break)) {
+      Text += '\n';
+      Text.append(Indent, ' ');
+    } else if (I > 0) {
+      Text.append(1 + Columns.Sizes[(I - 1) % Count] - Lengths[I - 1], ' ');
+    }
+    Text += Items[I];
+    if (I + 1 < Items.size())
+      Text += ',';
+  }
+  return true;
+}
+
+// Formats `Code` like reformatRegions(), but lays out braced lists of at least
+// CLANG_FORMAT_WASM_LARGE_LIST_ITEMS literals in time linear in their size. The
+// formatter sees each of them as a list of one item, which layoutList() then
+// replaces with all of them, after the brace or on the lines below it. This is
+// only done where the statement starts the line the formatter put the brace
+// in, so that the items decide nothing before the brace.
+static auto reformatLists(const FormatStyle &Style, StringRef Code,
+                          std::vector<tooling::Range> Ranges,
+                          StringRef FileName, bool FormatInChunks,
+                          FormattingAttemptStatus *Status)
+    -> tooling::Replacements {
+  auto FormatAll = [&] {
+    if (Status)
+      *Status = FormattingAttemptStatus();
+    return reformatRegions(Style, Code, Ranges, FileName, FormatInChunks,
+                           Status);
+  };
+
+  // The brace must end up where the formatter would put it with all the
+  // items in place: neighbouring assignments and declarations would align
+  // with the list while it is on a single line.
+  if (Code.size() < 2 * CLANG_FORMAT_WASM_LARGE_LIST_ITEMS || !Style.isCpp() ||
+      Style.DisableFormat || Style.ColumnLimit == 0 ||
+      !Style.Cpp11BracedListStyle ||
+      Style.UseTab != FormatStyle::UT_Never ||
+      Style.AlignAfterOpenBracket != FormatStyle::BAS_Align ||
+      Style.AlignConsecutiveAssignments.Enabled ||
+      Style.AlignConsecutiveDeclarations.Enabled ||
+      Code.contains("clang-format off"))
+    return FormatAll();
+
+  std::vector<BracedList> Lists =
+      largeBracedLists(Code, CLANG_FORMAT_WASM_LARGE_LIST_ITEMS);
+  // Lists are only laid out as a whole, and not when a trailing comment
+  // follows them.
+  llvm::erase_if(Lists, [&](const BracedList &List) {
+    StringRef Rest = Code.substr(List.End);
+    return Rest.take_until([](char C) { return C == '\n'; }).contains('/') ||
+           llvm::none_of(Ranges, [&](const tooling::Range &R) {
+             return R.getOffset() <= List.Begin &&
+                    R.getOffset() + R.getLength() > List.End;
+           });
+  });
+  if (Lists.empty())
+    return FormatAll();
+
+  tooling::Replacements Placeholders;
+  for (const BracedList &List : Lists) {
+    cantFail(Placeholders.add(tooling::Replacement(
+        FileName, List.Begin + 1, List.End - List.Begin - 1, "0")));
+  }
+  std::string Masked =
+      cantFail(tooling::applyAllReplacements(Code, Placeholders));
+  tooling::Replacements FormatChanges = reformatRegions(
+      Style, Masked,
+      tooling::calculateRangesAfterReplacements(Placeholders, Ranges),
+      FileName, FormatInChunks, Status);
+  // Lines of the masked code would not match those of `Code`.
+  if (Status && !Status->FormatComplete)
+    return FormatAll();
+  std::string Formatted =
+      cantFail(tooling::applyAllReplacements(Masked, FormatChanges));
+
+  tooling::Replacements Layouts;
+  for (const BracedList &List : Lists) {
+    unsigned Brace = FormatChanges.getShiftedCodePosition(
+        Placeholders.getShiftedCodePosition(List.Begin));
+    size_t Close = Formatted.find('}', Brace);
+    if (Brace >= Formatted.size() || Formatted[Brace] != '{' ||
+        Close == std::string::npos)
+      return FormatAll();
+
+    // layoutList() measures the last item with the `};` after it. A template
+    // declaration is only broken from the declaration when that does not fit
+    // on one line, and a statement that started on an earlier line may break
+    // differently around a longer list.
+    StringRef Before = StringRef(Formatted).take_front(Brace);
+    size_t LineStart = Before.rfind('\n') + 1;
+    StringRef Line = Before.substr(LineStart);
+    StringRef Previous = Before.take_front(LineStart).rtrim();
+    StringRef PreviousLine = Previous.substr(Previous.rfind('\n') + 1).ltrim();
+    if (StringRef(Formatted).substr(Close + 1).take_until([](char C) {
+          return C == '\n';
+        }) != ";" ||
+        Line.contains("template") ||
+        !(Previous.empty() || PreviousLine.starts_with("//") ||
+          PreviousLine.starts_with("#") || PreviousLine.ends_with("*/") ||
+          StringRef(";{}:").contains(PreviousLine.back())))
+      return FormatAll();
+
+    int BraceColumn = llvm::sys::unicode::columnWidthUTF8(Line);
+    unsigned LineIndent = Line.size() - Line.ltrim(' ').size();
+    std::string Text;
+    if (BraceColumn < 0 ||
+        !layoutList(Style, List.Items, BraceColumn, LineIndent, Text))
+      return FormatAll();
+    cantFail(Layouts.add(
+        tooling::Replacement(FileName, Brace + 1, Close - Brace - 1, Text)));
+  }
+  return Placeholders.merge(FormatChanges).merge(Layouts);
+}
+
+static auto reformat_code(const FormatStyle &Style, StringRef Code,
+                          StringRef AssumedFileName,
+                          std::vector<tooling::Range> ranges,
+                          bool FormatInChunks, Stats *CallStats) -> Result {
+  std::string DepthError = checkNestingDepth(Code);
+  if (!DepthError.empty())
+    return Result::error(DepthError);
+
+  PhaseTimer Timer(CallStats);
+
   unsigned CursorPosition = 0;
-  tooling::Replacements Replaces =
-      format::sortIncludes(*FormatStyle, code->getBuffer(), ranges,
-                           AssumedFileName, &CursorPosition);
+  tooling::Replacements Replaces = format::sortIncludes(
+      Style, Code, ranges, AssumedFileName, &CursorPosition);
+  Timer.lap(&Stats::sort_includes_ms);
+  if (CallStats)
+    CallStats->include_replacements += Replaces.size();
 
   // To format JSON insert a variable to trick the code into thinking its
   // JavaScript.
-  if (FormatStyle->isJson() && !FormatStyle->DisableFormat) {
+  if (Style.isJson() && !Style.DisableFormat) {
     auto err =
         Replaces.add(tooling::Replacement(AssumedFileName, 0, 0, "x = "));
     if (err)
       return Result::error("Bad Json variable insertion");
   }
 
-  auto ChangedCode =
-      cantFail(tooling::applyAllReplacements(code->getBuffer(), Replaces));
+  // Most inputs have their includes sorted already; formatting then works on
+  // `Code` itself instead of a copy with new ranges.
+  std::string SortedCode;
+  StringRef ChangedCode = Code;
+  if (!Replaces.empty()) {
+    SortedCode = cantFail(tooling::applyAllReplacements(Code, Replaces));
+    ChangedCode = SortedCode;
 
-  // Get new affected ranges after sorting `#includes`.
-  ranges = tooling::calculateRangesAfterReplacements(Replaces, ranges);
+    // Get new affected ranges after sorting `#includes`.
+    ranges = tooling::calculateRangesAfterReplacements(Replaces, ranges);
+  }
+
+  if (CallStats)
+    CallStats->tokens += countTokens(Style, ChangedCode);
+  Timer.lap(&Stats::apply_ms);
+
+  const unsigned long long PassesBefore = parsePassCount();
+  const unsigned long long LinesBefore = unwrappedLineCount();
+  const unsigned long long StatesBefore = penaltyStateCount();
   format::FormattingAttemptStatus Status;
-  tooling::Replacements FormatChanges = format::reformat(
-      *FormatStyle, ChangedCode, ranges, AssumedFileName, &Status);
-  Replaces = Replaces.merge(FormatChanges);
+  tooling::Replacements FormatChanges =
+      reformatLists(Style, ChangedCode, ranges, AssumedFileName,
+                    FormatInChunks, &Status);
+  Timer.lap(&Stats::reformat_ms);
+  if (CallStats) {
+    CallStats->parse_passes += parsePassCount() - PassesBefore;
+    CallStats->unwrapped_lines += unwrappedLineCount() - LinesBefore;
+    CallStats->penalty_states += penaltyStateCount() - StatesBefore;
+  }
 
+  // Applying the format changes to the sorted code gives the same result as
+  // applying both sets merged to `Code`; merging is only needed to count.
   std::string result =
-      cantFail(tooling::applyAllReplacements(code->getBuffer(), Replaces));
+      cantFail(tooling::applyAllReplacements(ChangedCode, FormatChanges));
+  Timer.lap(&Stats::apply_ms);
+  if (CallStats)
+    CallStats->replacements += Replaces.merge(FormatChanges).size();
 
-  if (Status.FormatComplete && result == code->getBuffer().str())
+  if (Status.FormatComplete && result == Code)
     return Result::unchanged();
 
   return Result::ok(result);
 }
 
-} // namespace format
-} // namespace clang
+static auto format_range(FormatterState &state,
+                         const std::unique_ptr<llvm::MemoryBuffer> code,
+                         const std::string assumedFileName,
+                         std::vector<tooling::Range> ranges,
+                         Stats *CallStats) -> Result {
+  StringRef BufStr = code->getBuffer();
+  if (CallStats)
+    CallStats->bytes += BufStr.size();
 
-ClangFormat::ClangFormat()
-    : style_(clang::format::DefaultFormatStyle),
-      fallback_style_(clang::format::DefaultFallbackStyle) {}
+  const char *InvalidBOM = SrcMgr::ContentCache::getInvalidBOM(BufStr);
 
-auto ClangFormat::with_style(const std::string style) -> ClangFormat * {
-  style_ = style;
-  return this;
+  if (InvalidBOM) {
+    std::stringstream err;
+    err << "encoding with unsupported byte order mark \"" << InvalidBOM
+        << "\" detected.";
+
+    return Result::error(err.str());
+  }
+
+  StringRef AssumedFileName = assumedFileName;
+  if (AssumedFileName.empty())
+    AssumedFileName = "<stdin>";
+
+  // Like the CLI, leave files matched by a registered ignore file as they are.
+  bool FormatInChunks;
+  {
+    std::lock_guard<std::mutex> Lock(state.Mutex);
+    if (AssumedFileName != "<stdin>" &&
+        state.Ignores.isIgnored(AssumedFileName))
+      return Result::unchanged();
+    FormatInChunks = state.FormatInChunks;
+  }
+
+  Expected<std::shared_ptr<const CachedStyle>> Cached =
+      getCachedStyle(state, AssumedFileName, code->getBuffer(), CallStats);
+
+  if (!Cached) {
+    std::string err = llvm::toString(Cached.takeError());
+    return Result::error(err);
+  }
+
+  return reformat_code(*styleForCode(**Cached, code->getBuffer()),
+                       code->getBuffer(), AssumedFileName, std::move(ranges),
+                       FormatInChunks, CallStats);
 }
 
-auto ClangFormat::with_fallback_style(const std::string style)
-    -> ClangFormat * {
-  fallback_style_ = style;
-  return this;
+static auto profile_lines(FormatterState &state, StringRef Code,
+                          StringRef AssumedFileName, unsigned Count)
+    -> Result {
+  std::string DepthError = checkNestingDepth(Code);
+  if (!DepthError.empty())
+    return Result::error(DepthError);
+
+  Expected<std::shared_ptr<const CachedStyle>> Cached =
+      getCachedStyle(state, AssumedFileName, Code, nullptr);
+  if (!Cached)
+    return Result::error(llvm::toString(Cached.takeError()));
+  std::shared_ptr<const FormatStyle> Style = styleForCode(**Cached, Code);
+
+  // Profile the code as reformat_code() passes it to the formatter.
+  std::string Input = Code.str();
+  if (Style->isJson())
+    Input.insert(0, "x = ");
+
+  std::string Report;
+  raw_string_ostream OS(Report);
+  printLineCosts(OS, profileLines(*Style, Input, AssumedFileName, Count));
+  return Result::ok(OS.str());
 }
 
-auto ClangFormat::format(const std::string code, const std::string filename)
+static auto format_file(FormatterState &state, const std::string &code,
+                        const std::string &filename, Stats *CallStats)
     -> Result {
   ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
       MemoryBuffer::getMemBuffer(code);
@@ -160,123 +1069,451 @@ auto ClangFormat::format(const std::string code, const std::string filename)
   if (Code->getBufferSize() == 0)
     return Result::unchanged();
 
-  std::vector<clang::tooling::Range> Ranges;
-  clang::format::fillRanges(Code.get(), Ranges);
+  std::vector<tooling::Range> Ranges;
+  fillRanges(Code.get(), Ranges);
 
-  return clang::format::format_range(std::move(Code), filename, style_,
-                                     fallback_style_, std::move(Ranges));
+  return format_range(state, std::move(Code), filename, std::move(Ranges),
+                      CallStats);
 }
 
-auto ClangFormat::format_range(const std::string code,
-                               const std::string filename, unsigned offset,
-                               unsigned length) -> Result {
-  ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
-      MemoryBuffer::getMemBuffer(code);
+// A fenced code block of a Markdown document. `Offset` and `Length` cover the
+// content lines between the fences, including the last line break.
+struct EmbeddedBlock {
+  StringRef Info;
+  unsigned Offset;
+  unsigned Length;
+  unsigned Indent;
+};
 
-  if (std::error_code EC = CodeOrErr.getError())
-    return Result::error(EC.message());
-  std::unique_ptr<llvm::MemoryBuffer> Code = std::move(CodeOrErr.get());
-  if (Code->getBufferSize() == 0)
-    return Result::unchanged();
+// Maps the info string of a fenced code block to a file name from which
+// clang-format guesses the language. Returns an empty name for languages
+// clang-format does not handle.
+static auto embeddedFileName(StringRef Info) -> StringRef {
+  std::string Language = Info.trim().split(' ').first.lower();
+  return StringSwitch<StringRef>(Language)
+      .Cases("c", "h", "<embedded>.c")
+      .Cases("cpp", "c++", "cc", "cxx", "hpp", "<embedded>.cc")
+      .Cases("objc", "objective-c", "objectivec", "<embedded>.m")
+      .Cases("objcpp", "objc++", "objective-c++", "<embedded>.mm")
+      .Cases("cs", "csharp", "c#", "<embedded>.cs")
+      .Case("java", "<embedded>.java")
+      .Cases("js", "javascript", "jsx", "mjs", "cjs", "<embedded>.js")
+      .Cases("ts", "typescript", "tsx", "<embedded>.ts")
+      .Case("json", "<embedded>.json")
+      .Cases("proto", "protobuf", "<embedded>.proto")
+      .Cases("textproto", "pbtxt", "txtpb", "<embedded>.textproto")
+      .Cases("verilog", "systemverilog", "sv", "<embedded>.sv")
+      .Cases("tablegen", "td", "<embedded>.td")
+      .Default("");
+}
 
-  std::vector<clang::tooling::Range> Ranges;
+// Finds the fenced code blocks (```lang or ~~~lang) of a Markdown document.
+// Blocks without a closing fence are skipped.
+static auto findMarkdownBlocks(StringRef Document)
+    -> std::vector<EmbeddedBlock> {
+  std::vector<EmbeddedBlock> Blocks;
 
-  IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
-      new llvm::vfs::InMemoryFileSystem);
-  clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
-  clang::DiagnosticOptions DiagOpts;
-  clang::DiagnosticsEngine Diagnostics(
-      IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
-      DiagOpts);
-  clang::SourceManager Sources(Diagnostics, Files);
-  clang::FileID ID = clang::format::createInMemoryFile(
-      "<irrelevant>", *Code, Sources, Files, InMemoryFileSystem.get());
-
-  if (length == 0) {
-    if (offset >= Code->getBufferSize()) {
-      std::stringstream err;
-      err << "offset " << offset << " is outside the file";
-      return Result::error(err.str());
-    }
-    clang::SourceLocation Start =
-        Sources.getLocForStartOfFile(ID).getLocWithOffset(offset);
-    clang::SourceLocation End = Sources.getLocForEndOfFile(ID);
+  char FenceChar = 0;
+  size_t FenceLength = 0;
+  EmbeddedBlock Block{};
 
-    unsigned Offset = Sources.getFileOffset(Start);
-    unsigned Length = Sources.getFileOffset(End) - Offset;
+  for (size_t Pos = 0; Pos < Document.size();) {
+    size_t EOL = Document.find('\n', Pos);
+    size_t Next = EOL == StringRef::npos ? Document.size() : EOL + 1;
+    StringRef Line = Document.slice(Pos, Next).rtrim("\r\n");
 
-    Ranges.push_back(clang::tooling::Range(Offset, Length));
-  } else {
-    if (offset >= Code->getBufferSize()) {
-      std::stringstream err;
-      err << "offset " << offset << " is outside the file";
-      return Result::error(err.str());
+    StringRef Text = Line.ltrim(' ');
+    unsigned Indent = Line.size() - Text.size();
+    char C = Text.empty() ? 0 : Text[0];
+    size_t Run = (C == '`' || C == '~') ? Text.find_first_not_of(C) : 0;
+    if (Run == StringRef::npos)
+      Run = Text.size();
+
+    if (FenceChar == 0) {
+      if (Run >= 3 && (C == '~' || !Text.drop_front(Run).contains('`'))) {
+        FenceChar = C;
+        FenceLength = Run;
+        Block = {Text.drop_front(Run), static_cast<unsigned>(Next), 0, Indent};
+      }
+    } else if (C == FenceChar && Run >= FenceLength &&
+               Text.drop_front(Run).trim().empty()) {
+      Block.Length = Pos - Block.Offset;
+      Blocks.push_back(Block);
+      FenceChar = 0;
     }
 
-    unsigned end = offset + length;
-    if (end > Code->getBufferSize()) {
-      std::stringstream err;
-      err << "invalid length " << length << ", offset + length (" << end
-          << ") is outside the file.";
-      return Result::error(err.str());
+    Pos = Next;
+  }
+
+  return Blocks;
+}
+
+// Removes up to `Indent` leading spaces from every line of `Code`.
+static auto dedent(StringRef Code, unsigned Indent) -> std::string {
+  std::string Out;
+  Out.reserve(Code.size());
+  while (!Code.empty()) {
+    auto [Line, Rest] = Code.split('\n');
+    size_t Spaces = std::min<size_t>(Indent, Line.find_first_not_of(' '));
+    Out += Line.drop_front(std::min(Spaces, Line.size()));
+    if (Line.size() < Code.size())
+      Out += '\n';
+    Code = Rest;
+  }
+  return Out;
+}
+
+// Prefixes every non-empty line of `Code` with `Indent` spaces.
+static auto reindent(StringRef Code, unsigned Indent) -> std::string {
+  std::string Out;
+  Out.reserve(Code.size());
+  const std::string Prefix(Indent, ' ');
+  while (!Code.empty()) {
+    auto [Line, Rest] = Code.split('\n');
+    if (!Line.empty())
+      Out += Prefix;
+    Out += Line;
+    if (Line.size() < Code.size())
+      Out += '\n';
+    Code = Rest;
+  }
+  return Out;
+}
+
+static auto format_embedded(FormatterState &state, StringRef Document,
+                            Stats *CallStats) -> Result {
+  const std::vector<EmbeddedBlock> Blocks = findMarkdownBlocks(Document);
+  std::vector<Result> Formatted(Blocks.size(), Result::unchanged());
+  std::vector<Stats> BlockStats(CallStats ? Blocks.size() : 0);
+
+  forEachIndex(Blocks.size(), [&](size_t Index) {
+    const EmbeddedBlock &Block = Blocks[Index];
+    StringRef FileName = embeddedFileName(Block.Info);
+    StringRef Content = Document.substr(Block.Offset, Block.Length);
+    if (FileName.empty() || Content.trim().empty())
+      return;
+
+    std::string Code = dedent(Content, Block.Indent);
+    Stats *Counters = CallStats ? &BlockStats[Index] : nullptr;
+
+    Expected<std::shared_ptr<const CachedStyle>> Cached =
+        getCachedStyle(state, FileName, Code, Counters);
+    if (!Cached) {
+      Formatted[Index] = Result::error(llvm::toString(Cached.takeError()));
+      return;
     }
 
-    clang::SourceLocation Start =
-        Sources.getLocForStartOfFile(ID).getLocWithOffset(offset);
-    clang::SourceLocation End = Start.getLocWithOffset(length);
+    Formatted[Index] = reformat_code(
+        *styleForCode(**Cached, Code), Code, FileName,
+        {tooling::Range(0, static_cast<unsigned>(Code.size()))},
+        /*FormatInChunks=*/false, Counters);
+  });
 
-    unsigned Offset = Sources.getFileOffset(Start);
-    unsigned Length = Sources.getFileOffset(End) - Offset;
+  if (CallStats) {
+    CallStats->bytes += Document.size();
+    for (const Stats &Counters : BlockStats)
+      addStats(*CallStats, Counters);
+  }
 
-    Ranges.push_back(clang::tooling::Range(Offset, Length));
+  tooling::Replacements Replaces;
+
+  for (size_t Index = 0; Index < Blocks.size(); ++Index) {
+    const EmbeddedBlock &Block = Blocks[Index];
+    if (Formatted[Index].status == ResultStatus::Error)
+      return Formatted[Index];
+    if (Formatted[Index].status == ResultStatus::Unchanged)
+      continue;
+
+    std::string Text = reindent(Formatted[Index].content, Block.Indent);
+    if (Text == Document.substr(Block.Offset, Block.Length))
+      continue;
+
+    if (auto Err = Replaces.add(tooling::Replacement(
+            "<document>", Block.Offset, Block.Length, Text)))
+      return Result::error(llvm::toString(std::move(Err)));
   }
 
-  return clang::format::format_range(
-      std::move(Code), filename, style_, fallback_style_, std::move(Ranges));
+  if (Replaces.empty())
+    return Result::unchanged();
+
+  return Result::ok(
+      cantFail(tooling::applyAllReplacements(Document, Replaces)));
+}
+
+} // namespace format
+} // namespace clang
+
+ClangFormat::ClangFormat() : state_(std::make_unique<FormatterState>()) {}
+
+ClangFormat::~ClangFormat() = default;
+
+auto ClangFormat::with_style(const std::string style) -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->Style = style;
+  state_->Styles.clear();
+  return this;
+}
+
+auto ClangFormat::with_fallback_style(const std::string style)
+    -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->FallbackStyle = style;
+  state_->Styles.clear();
+  return this;
+}
+
+auto ClangFormat::with_config(const std::string directory,
+                              const std::string config) -> ClangFormat * {
+  clang::format::setConfig(*state_, directory, &config);
+  return this;
+}
+
+auto ClangFormat::without_config(const std::string directory)
+    -> ClangFormat * {
+  clang::format::setConfig(*state_, directory, nullptr);
+  return this;
+}
+
+auto ClangFormat::with_ignore(const std::string directory,
+                              const std::string patterns) -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->Ignores.add(directory, patterns);
+  return this;
+}
+
+auto ClangFormat::without_ignore(const std::string directory)
+    -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->Ignores.remove(directory);
+  return this;
+}
+
+auto ClangFormat::is_ignored(const std::string path) -> bool {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  return state_->Ignores.isIgnored(path);
+}
+
+auto ClangFormat::filter_ignored(const std::vector<std::string> paths)
+    -> std::vector<std::string> {
+  std::vector<bool> Ignored;
+  {
+    std::lock_guard<std::mutex> Lock(state_->Mutex);
+    Ignored = state_->Ignores.isIgnored(paths);
+  }
+
+  std::vector<std::string> Kept;
+  for (size_t Index = 0; Index < paths.size(); ++Index) {
+    if (!Ignored[Index])
+      Kept.push_back(paths[Index]);
+  }
+  return Kept;
+}
+
+auto ClangFormat::with_stats(bool enabled) -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->CollectStats = enabled;
+  state_->LastStats = {};
+  return this;
+}
+
+auto ClangFormat::with_chunking(bool enabled) -> ClangFormat * {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  state_->FormatInChunks = enabled;
+  return this;
+}
+
+auto ClangFormat::last_stats() -> Stats {
+  std::lock_guard<std::mutex> Lock(state_->Mutex);
+  return state_->LastStats;
+}
+
+auto ClangFormat::format(const std::string code, const std::string filename)
+    -> Result {
+  return clang::format::withStats(*state_, [&](Stats *CallStats) {
+    return clang::format::format_file(*state_, code, filename, CallStats);
+  });
+}
+
+auto ClangFormat::format_range(const std::string code,
+                               const std::string filename, unsigned offset,
+                               unsigned length) -> Result {
+  return clang::format::withStats(*state_, [&](Stats *CallStats) -> Result {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
+        MemoryBuffer::getMemBuffer(code);
+
+    if (std::error_code EC = CodeOrErr.getError())
+      return Result::error(EC.message());
+    std::unique_ptr<llvm::MemoryBuffer> Code = std::move(CodeOrErr.get());
+    if (Code->getBufferSize() == 0)
+      return Result::unchanged();
+
+    std::vector<clang::tooling::Range> Ranges;
+
+    IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
+        new llvm::vfs::InMemoryFileSystem);
+    clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
+    clang::DiagnosticOptions DiagOpts;
+    clang::DiagnosticsEngine Diagnostics(
+        IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
+        DiagOpts);
+    clang::SourceManager Sources(Diagnostics, Files);
+    clang::FileID ID = clang::format::createInMemoryFile(
+        "<irrelevant>", *Code, Sources, Files, InMemoryFileSystem.get());
+
+    if (length == 0) {
+      if (offset >= Code->getBufferSize()) {
+        std::stringstream err;
+        err << "offset " << offset << " is outside the file";
+        return Result::error(err.str());
+      }
+      clang::SourceLocation Start =
+          Sources.getLocForStartOfFile(ID).getLocWithOffset(offset);
+      clang::SourceLocation End = Sources.getLocForEndOfFile(ID);
+
+      unsigned Offset = Sources.getFileOffset(Start);
+      unsigned Length = Sources.getFileOffset(End) - Offset;
+
+      Ranges.push_back(clang::tooling::Range(Offset, Length));
+    } else {
+      if (offset >= Code->getBufferSize()) {
+        std::stringstream err;
+        err << "offset " << offset << " is outside the file";
+        return Result::error(err.str());
+      }
+
+      unsigned end = offset + length;
+      if (end > Code->getBufferSize()) {
+        std::stringstream err;
+        err << "invalid length " << length << ", offset + length (" << end
+            << ") is outside the file.";
+        return Result::error(err.str());
+      }
+
+      clang::SourceLocation Start =
+          Sources.getLocForStartOfFile(ID).getLocWithOffset(offset);
+      clang::SourceLocation End = Start.getLocWithOffset(length);
+
+      unsigned Offset = Sources.getFileOffset(Start);
+      unsigned Length = Sources.getFileOffset(End) - Offset;
+
+      Ranges.push_back(clang::tooling::Range(Offset, Length));
+    }
+
+    return clang::format::format_range(*state_, std::move(Code), filename,
+                                       std::move(Ranges), CallStats);
+  });
 }
 
 auto ClangFormat::format_line(const std::string code,
                               const std::string filename, unsigned from_line,
                               unsigned to_line) -> Result {
-  ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
-      MemoryBuffer::getMemBuffer(code);
+  return clang::format::withStats(*state_, [&](Stats *CallStats) -> Result {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> CodeOrErr =
+        MemoryBuffer::getMemBuffer(code);
 
-  if (std::error_code EC = CodeOrErr.getError())
-    return Result::error(EC.message());
-  std::unique_ptr<llvm::MemoryBuffer> Code = std::move(CodeOrErr.get());
-  if (Code->getBufferSize() == 0)
-    return Result::unchanged();
+    if (std::error_code EC = CodeOrErr.getError())
+      return Result::error(EC.message());
+    std::unique_ptr<llvm::MemoryBuffer> Code = std::move(CodeOrErr.get());
+    if (Code->getBufferSize() == 0)
+      return Result::unchanged();
 
-  if (from_line < 1)
-    return Result::error("start line should be at least 1");
-  if (from_line > to_line)
-    return Result::error("start line should not exceed end line");
+    if (from_line < 1)
+      return Result::error("start line should be at least 1");
+    if (from_line > to_line)
+      return Result::error("start line should not exceed end line");
 
-  std::vector<clang::tooling::Range> Ranges;
+    std::vector<clang::tooling::Range> Ranges;
 
-  IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
-      new llvm::vfs::InMemoryFileSystem);
-  clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
-  clang::DiagnosticOptions DiagOpts;
-  clang::DiagnosticsEngine Diagnostics(
-      IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
-      DiagOpts);
-  clang::SourceManager Sources(Diagnostics, Files);
-  clang::FileID ID = clang::format::createInMemoryFile(
-      "<irrelevant>", *Code, Sources, Files, InMemoryFileSystem.get());
-
-  const auto Start = Sources.translateLineCol(ID, from_line, 1);
-  const auto End = Sources.translateLineCol(ID, to_line, UINT_MAX);
-  if (Start.isInvalid() || End.isInvalid())
-    return Result::error("invalid line range");
-
-  const auto Offset = Sources.getFileOffset(Start);
-  const auto Length = Sources.getFileOffset(End) - Offset;
-
-  Ranges.push_back(clang::tooling::Range(Offset, Length));
-
-  return clang::format::format_range(
-      std::move(Code), filename, style_, fallback_style_, std::move(Ranges));
+    IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> InMemoryFileSystem(
+        new llvm::vfs::InMemoryFileSystem);
+    clang::FileManager Files(clang::FileSystemOptions(), InMemoryFileSystem);
+    clang::DiagnosticOptions DiagOpts;
+    clang::DiagnosticsEngine Diagnostics(
+        IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
+        DiagOpts);
+    clang::SourceManager Sources(Diagnostics, Files);
+    clang::FileID ID = clang::format::createInMemoryFile(
+        "<irrelevant>", *Code, Sources, Files, InMemoryFileSystem.get());
+
+    const auto Start = Sources.translateLineCol(ID, from_line, 1);
+    const auto End = Sources.translateLineCol(ID, to_line, UINT_MAX);
+    if (Start.isInvalid() || End.isInvalid())
+      return Result::error("invalid line range");
+
+    const auto Offset = Sources.getFileOffset(Start);
+    const auto Length = Sources.getFileOffset(End) - Offset;
+
+    Ranges.push_back(clang::tooling::Range(Offset, Length));
+
+    return clang::format::format_range(*state_, std::move(Code), filename,
+                                       std::move(Ranges), CallStats);
+  });
+}
+
+auto ClangFormat::format_changed(const std::string old_code,
+                                 const std::string new_code,
+                                 const std::string filename) -> Result {
+  return clang::format::withStats(*state_, [&](Stats *CallStats) -> Result {
+    std::vector<clang::tooling::Range> Ranges =
+        clang::format::changedRanges(old_code, new_code);
+    if (Ranges.empty())
+      return Result::unchanged();
+
+    std::unique_ptr<llvm::MemoryBuffer> Code =
+        MemoryBuffer::getMemBuffer(new_code);
+    return clang::format::format_range(*state_, std::move(Code), filename,
+                                       std::move(Ranges), CallStats);
+  });
+}
+
+auto ClangFormat::format_batch(const std::vector<std::string> codes,
+                               const std::vector<std::string> filenames)
+    -> std::vector<Result> {
+  return clang::format::withStats(
+      *state_, [&](Stats *CallStats) -> std::vector<Result> {
+        if (codes.size() != filenames.size()) {
+          std::stringstream err;
+          err << "number of codes (" << codes.size()
+              << ") and filenames (" << filenames.size() << ") must match";
+          return {Result::error(err.str())};
+        }
+
+        std::vector<Result> Results(codes.size(), Result::unchanged());
+        std::vector<Stats> FileStats(CallStats ? codes.size() : 0);
+
+        clang::format::forEachIndex(codes.size(), [&](size_t Index) {
+          Results[Index] = clang::format::format_file(
+              *state_, codes[Index], filenames[Index],
+              CallStats ? &FileStats[Index] : nullptr);
+        });
+
+        for (const Stats &Counters : FileStats)
+          clang::format::addStats(*CallStats, Counters);
+        return Results;
+      });
+}
+
+auto ClangFormat::format_embedded(const std::string document,
+                                  const std::string kind) -> Result {
+  return clang::format::withStats(*state_, [&](Stats *CallStats) -> Result {
+    if (StringRef(kind).lower() != "markdown") {
+      std::stringstream err;
+      err << "unsupported document kind \"" << kind << "\"";
+      return Result::error(err.str());
+    }
+
+    return clang::format::format_embedded(*state_, document, CallStats);
+  });
+}
+
+auto ClangFormat::profile_lines(const std::string code,
+                                const std::string filename, unsigned count)
+    -> Result {
+  return clang::format::profile_lines(*state_, code, filename, count);
+}
+
+auto ClangFormat::heap_stats() -> HeapStats {
+  return clang::format::heapStats();
 }
 
 auto ClangFormat::version() -> std::string {
@@ -1,6 +1,8 @@
 #ifndef CLANG_FORMAT_WASM_LIB_H_
 #define CLANG_FORMAT_WASM_LIB_H_
+#include <memory>
 #include <sstream>
+#include <vector>
 
 enum class ResultStatus { Success, Error, Unchanged };
 
@@ -19,24 +21,83 @@ struct Result {
   }
 };
 
+// Work done by the last call of a ClangFormat instance, collected after
+// `with_stats(true)`. Times are in milliseconds; calls that format several
+// files or blocks report the sum over all of them. The heap fields cover the
+// whole call, its peak being measured above the live bytes at its start, and
+// are doubles like the totals of `HeapStats`.
+struct Stats {
+  unsigned bytes;
+  unsigned tokens;
+  unsigned replacements;
+  unsigned include_replacements;
+  unsigned styles_resolved;
+  double style_ms;
+  double sort_includes_ms;
+  double reformat_ms;
+  double apply_ms;
+  double heap_allocated_bytes;
+  double heap_allocations;
+  double heap_peak_bytes;
+  unsigned parse_passes;
+  unsigned unwrapped_lines;
+  unsigned penalty_states;
+};
+
+// Heap usage of the module since it was instantiated. Byte and allocation
+// totals only grow and are doubles so they do not wrap in long-lived modules.
+struct HeapStats {
+  double allocated_bytes;
+  double freed_bytes;
+  double allocations;
+  double frees;
+  unsigned current_bytes;
+  unsigned peak_bytes;
+  unsigned memory_bytes;
+};
+
+struct FormatterState;
+
 class ClangFormat {
 public:
   ClangFormat();
+  ~ClangFormat();
   ClangFormat *with_style(const std::string style);
   ClangFormat *with_fallback_style(const std::string style);
+  ClangFormat *with_config(const std::string directory,
+                           const std::string config);
+  ClangFormat *without_config(const std::string directory);
+  ClangFormat *with_ignore(const std::string directory,
+                           const std::string patterns);
+  ClangFormat *without_ignore(const std::string directory);
+  ClangFormat *with_stats(bool enabled);
+  ClangFormat *with_chunking(bool enabled);
   Result format(const std::string code, const std::string filename);
   Result format_range(const std::string code, const std::string filename,
                       unsigned offset, unsigned length);
   Result format_line(const std::string code, const std::string filename,
                      unsigned from_line, unsigned to_line);
+  Result format_changed(const std::string old_code, const std::string new_code,
+                        const std::string filename);
+  std::vector<Result> format_batch(const std::vector<std::string> codes,
+                                   const std::vector<std::string> filenames);
+  Result format_embedded(const std::string document, const std::string kind);
+  Result profile_lines(const std::string code, const std::string filename,
+                       unsigned count);
+
+  bool is_ignored(const std::string path);
+  std::vector<std::string>
+  filter_ignored(const std::vector<std::string> paths);
+
+  Stats last_stats();
 
+  static HeapStats heap_stats();
   static std::string version();
   static Result dump_config(const std::string style, const std::string filename,
                             const std::string code);
 
 private:
-  std::string style_;
-  std::string fallback_style_;
+  std::unique_ptr<FormatterState> state_;
 };
 
 #endif
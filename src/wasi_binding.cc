@@ -24,6 +24,44 @@ struct WasmResult {
 
 static WasmResult g_last_result = {0, nullptr, 0};
 
+// Stats structure in linear memory, see `Stats` in lib.h
+// Layout: 5 x int32 counters, 4 bytes padding, 4 x float64 milliseconds,
+//         3 x float64 heap counters, 1 x int32 parse passes,
+//         2 x int32 unwrapped lines and penalty states, 4 bytes padding
+struct WasmStats {
+    int32_t bytes;
+    int32_t tokens;
+    int32_t replacements;
+    int32_t include_replacements;
+    int32_t styles_resolved;
+    double style_ms;
+    double sort_includes_ms;
+    double reformat_ms;
+    double apply_ms;
+    double heap_allocated_bytes;
+    double heap_allocations;
+    double heap_peak_bytes;
+    int32_t parse_passes;
+    int32_t unwrapped_lines;
+    int32_t penalty_states;
+};
+
+static WasmStats g_last_stats = {};
+
+// Heap stats structure in linear memory, see `HeapStats` in lib.h
+// Layout: 4 x float64 totals, 3 x int32 bytes
+struct WasmHeapStats {
+    double allocated_bytes;
+    double freed_bytes;
+    double allocations;
+    double frees;
+    int32_t current_bytes;
+    int32_t peak_bytes;
+    int32_t memory_bytes;
+};
+
+static WasmHeapStats g_heap_stats = {};
+
 // Memory management helpers - these will be called from Rust
 extern "C" {
 
@@ -65,6 +103,145 @@ int wasm_set_fallback_style(const char* style, int style_len) {
     return 0;
 }
 
+// Register the .clang-format of a directory (returns 0 on success)
+WASM_EXPORT
+int wasm_set_config(const char* directory, int directory_len,
+                    const char* config, int config_len) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->with_config(std::string(directory, directory_len),
+                             std::string(config, config_len));
+    return 0;
+}
+
+// Remove the .clang-format of a directory (returns 0 on success)
+WASM_EXPORT
+int wasm_remove_config(const char* directory, int directory_len) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->without_config(std::string(directory, directory_len));
+    return 0;
+}
+
+// Register the .clang-format-ignore of a directory (returns 0 on success)
+WASM_EXPORT
+int wasm_set_ignore(const char* directory, int directory_len,
+                    const char* patterns, int patterns_len) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->with_ignore(std::string(directory, directory_len),
+                             std::string(patterns, patterns_len));
+    return 0;
+}
+
+// Check a path against the registered ignore files
+// 1 = ignored, 0 = not ignored, -1 = not initialized
+WASM_EXPORT
+int wasm_is_ignored(const char* path, int path_len) {
+    if (g_formatter == nullptr) return -1;
+    return g_formatter->is_ignored(std::string(path, path_len)) ? 1 : 0;
+}
+
+// Remove the .clang-format-ignore of a directory (returns 0 on success)
+WASM_EXPORT
+int wasm_remove_ignore(const char* directory, int directory_len) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->without_ignore(std::string(directory, directory_len));
+    return 0;
+}
+
+// Check newline-separated paths against the registered ignore files in one
+// call. The paths that are not ignored are stored newline-separated in the
+// result, see wasm_get_result_ptr/len.
+// 0 = Success, 1 = Error
+WASM_EXPORT
+int wasm_filter_ignored(const char* paths, int paths_len) {
+    if (g_last_result.content_ptr != nullptr) {
+        free(g_last_result.content_ptr);
+        g_last_result.content_ptr = nullptr;
+    }
+    g_last_result.content_len = 0;
+    if (g_formatter == nullptr) {
+        g_last_result.status = 1;
+        return 1;
+    }
+
+    std::vector<std::string> path_list;
+    const char* end = paths + paths_len;
+    for (const char* start = paths; start < end;) {
+        const char* newline = (const char*)memchr(start, '\n', end - start);
+        const char* stop = newline != nullptr ? newline : end;
+        if (stop != start)
+            path_list.emplace_back(start, stop);
+        start = stop + 1;
+    }
+
+    std::string kept;
+    for (const std::string& path : g_formatter->filter_ignored(path_list)) {
+        kept += path;
+        kept += '\n';
+    }
+
+    g_last_result.status = 0;
+    if (!kept.empty()) {
+        g_last_result.content_len = kept.size();
+        g_last_result.content_ptr = (char*)malloc(kept.size());
+        memcpy(g_last_result.content_ptr, kept.data(), kept.size());
+    }
+    return 0;
+}
+
+// Enable (1) or disable (0) stats collection (returns 0 on success)
+WASM_EXPORT
+int wasm_set_stats(int enabled) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->with_stats(enabled != 0);
+    return 0;
+}
+
+// Enable (1) or disable (0) formatting large files in chunks (returns 0 on
+// success)
+WASM_EXPORT
+int wasm_set_chunking(int enabled) {
+    if (g_formatter == nullptr) return -1;
+    g_formatter->with_chunking(enabled != 0);
+    return 0;
+}
+
+// Get stats of the last format call, valid until the next call
+WASM_EXPORT
+const WasmStats* wasm_get_stats() {
+    if (g_formatter == nullptr) return nullptr;
+    Stats stats = g_formatter->last_stats();
+    g_last_stats.bytes = stats.bytes;
+    g_last_stats.tokens = stats.tokens;
+    g_last_stats.replacements = stats.replacements;
+    g_last_stats.include_replacements = stats.include_replacements;
+    g_last_stats.styles_resolved = stats.styles_resolved;
+    g_last_stats.style_ms = stats.style_ms;
+    g_last_stats.sort_includes_ms = stats.sort_includes_ms;
+    g_last_stats.reformat_ms = stats.reformat_ms;
+    g_last_stats.apply_ms = stats.apply_ms;
+    g_last_stats.heap_allocated_bytes = stats.heap_allocated_bytes;
+    g_last_stats.heap_allocations = stats.heap_allocations;
+    g_last_stats.heap_peak_bytes = stats.heap_peak_bytes;
+    g_last_stats.parse_passes = stats.parse_passes;
+    g_last_stats.unwrapped_lines = stats.unwrapped_lines;
+    g_last_stats.penalty_states = stats.penalty_states;
+    return &g_last_stats;
+}
+
+// Get heap stats of the module, valid until the next call
+WASM_EXPORT
+const WasmHeapStats* wasm_get_heap_stats() {
+    HeapStats stats = ClangFormat::heap_stats();
+    g_heap_stats.allocated_bytes = stats.allocated_bytes;
+    g_heap_stats.freed_bytes = stats.freed_bytes;
+    g_heap_stats.allocations = stats.allocations;
+    g_heap_stats.frees = stats.frees;
+    g_heap_stats.current_bytes = stats.current_bytes;
+    g_heap_stats.peak_bytes = stats.peak_bytes;
+    g_heap_stats.memory_bytes = stats.memory_bytes;
+    return &g_heap_stats;
+}
+
 // Format code - stores result in global, returns status
 // 0 = Success, 1 = Error, 2 = Unchanged
 WASM_EXPORT
@@ -0,0 +1,151 @@
+// Declarations of a table-driven schema DSL. Every statement is a macro
+// invocation; with the `Macros` style option clang-format expands them to
+// see the declarations they stand for.
+#include "schema/dsl.h"
+
+namespace schema {
+
+void defineUser(Registry &R) {
+  TABLE_BEGIN(R, User);
+  FIELD(R, int64_t, id);
+  FIELD(R, std::string, name);
+  FIELD(R, std::string, email);
+  FIELD(R, int32_t, age);
+  FIELD(R, bool, active);
+  PRIMARY_KEY(R, id);
+  TABLE_END(R, User);
+}
+
+bool validateUser(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_NOT_EMPTY(Row, name);
+  CHECK_NOT_EMPTY(Row, email);
+  CHECK_GE(Row, age, 0);
+  return true;
+}
+
+void defineOrder(Registry &R) {
+  TABLE_BEGIN(R, Order);
+  FIELD(R, int64_t, id);
+  FIELD(R, int64_t, user_id);
+  FIELD(R, double, total);
+  FIELD(R, std::string, currency);
+  FIELD(R, int64_t, created_at);
+  PRIMARY_KEY(R, id);
+  FOREIGN_KEY(R, user_id, User, id);
+  INDEX(R, order_by_user_id, user_id);
+  TABLE_END(R, Order);
+}
+
+bool validateOrder(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_GE(Row, user_id, 0);
+  CHECK_GE(Row, total, 0);
+  CHECK_NOT_EMPTY(Row, currency);
+  CHECK_GE(Row, created_at, 0);
+  return true;
+}
+
+void defineItem(Registry &R) {
+  TABLE_BEGIN(R, Item);
+  FIELD(R, int64_t, id);
+  FIELD(R, int64_t, order_id);
+  FIELD(R, std::string, sku);
+  FIELD(R, int32_t, quantity);
+  FIELD(R, double, price);
+  PRIMARY_KEY(R, id);
+  FOREIGN_KEY(R, order_id, Order, id);
+  INDEX(R, item_by_order_id, order_id);
+  TABLE_END(R, Item);
+}
+
+bool validateItem(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_GE(Row, order_id, 0);
+  CHECK_NOT_EMPTY(Row, sku);
+  CHECK_GE(Row, quantity, 0);
+  CHECK_GE(Row, price, 0);
+  return true;
+}
+
+void defineAddress(Registry &R) {
+  TABLE_BEGIN(R, Address);
+  FIELD(R, int64_t, id);
+  FIELD(R, int64_t, user_id);
+  FIELD(R, std::string, street);
+  FIELD(R, std::string, city);
+  FIELD(R, std::string, country);
+  PRIMARY_KEY(R, id);
+  FOREIGN_KEY(R, user_id, User, id);
+  INDEX(R, address_by_user_id, user_id);
+  TABLE_END(R, Address);
+}
+
+bool validateAddress(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_GE(Row, user_id, 0);
+  CHECK_NOT_EMPTY(Row, street);
+  CHECK_NOT_EMPTY(Row, city);
+  CHECK_NOT_EMPTY(Row, country);
+  return true;
+}
+
+void definePayment(Registry &R) {
+  TABLE_BEGIN(R, Payment);
+  FIELD(R, int64_t, id);
+  FIELD(R, int64_t, order_id);
+  FIELD(R, double, amount);
+  FIELD(R, std::string, method);
+  FIELD(R, bool, settled);
+  PRIMARY_KEY(R, id);
+  FOREIGN_KEY(R, order_id, Order, id);
+  INDEX(R, payment_by_order_id, order_id);
+  TABLE_END(R, Payment);
+}
+
+bool validatePayment(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_GE(Row, order_id, 0);
+  CHECK_GE(Row, amount, 0);
+  CHECK_NOT_EMPTY(Row, method);
+  return true;
+}
+
+void defineShipment(Registry &R) {
+  TABLE_BEGIN(R, Shipment);
+  FIELD(R, int64_t, id);
+  FIELD(R, int64_t, order_id);
+  FIELD(R, std::string, carrier);
+  FIELD(R, std::string, tracking);
+  FIELD(R, int64_t, shipped_at);
+  PRIMARY_KEY(R, id);
+  FOREIGN_KEY(R, order_id, Order, id);
+  INDEX(R, shipment_by_order_id, order_id);
+  TABLE_END(R, Shipment);
+}
+
+bool validateShipment(const Row &Row) {
+  CHECK_GE(Row, id, 0);
+  CHECK_GE(Row, order_id, 0);
+  CHECK_NOT_EMPTY(Row, carrier);
+  CHECK_NOT_EMPTY(Row, tracking);
+  CHECK_GE(Row, shipped_at, 0);
+  return true;
+}
+
+void defineSchema(Registry &R) {
+  defineUser(R);
+  VALIDATOR(R, User, validateUser);
+  defineOrder(R);
+  VALIDATOR(R, Order, validateOrder);
+  defineItem(R);
+  VALIDATOR(R, Item, validateItem);
+  defineAddress(R);
+  VALIDATOR(R, Address, validateAddress);
+  definePayment(R);
+  VALIDATOR(R, Payment, validatePayment);
+  defineShipment(R);
+  VALIDATOR(R, Shipment, validateShipment);
+}
+
+} // namespace schema
@@ -0,0 +1,17 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { format, format_batch } from "../pkg/clang-format-node.js";
+
+const files = [
+	{ content: "int  main(){return 0;}\n", filename: "main.cc" },
+	{ content: "class A{int  x;}\n", filename: "A.java" },
+	{ content: "int x = 1;\n", filename: "formatted.c" },
+];
+
+test("should format a batch of files", () => {
+	const actual = format_batch(files);
+	const expected = files.map(({ content, filename }) => format(content, filename));
+
+	assert.deepEqual(actual, expected);
+	assert.equal(actual[2], files[2].content);
+});
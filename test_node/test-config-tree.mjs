@@ -0,0 +1,54 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { ClangFormat } from "../pkg/clang-format-node.js";
+
+const code = "int main() {\n  return 0;\n}\n";
+const indented = "int main() {\n    return 0;\n}\n";
+
+test("should resolve registered configs by directory", () => {
+	const formatter = new ClangFormat()
+		.with_config("", "BasedOnStyle: LLVM")
+		.with_config("a/b", "BasedOnStyle: LLVM\nIndentWidth: 4");
+
+	assert.equal(formatter.format(code, "main.cc"), code);
+	assert.equal(formatter.format(code, "a/main.cc"), code);
+	assert.equal(formatter.format(code, "a/b/c/main.cc"), indented);
+});
+
+test("should inherit parent configs", () => {
+	const short_if = "int main() {\n  if (x) return 1;\n  return 0;\n}\n";
+	const formatter = new ClangFormat()
+		.with_config("/", "BasedOnStyle: LLVM\nAllowShortIfStatementsOnASingleLine: WithoutElse")
+		.with_config("a", "InheritParentConfig: true\nIndentWidth: 4");
+
+	assert.equal(formatter.format(short_if, "main.cc"), short_if);
+	assert.equal(formatter.format(short_if, "a/main.cc"), short_if.replaceAll("  ", "    "));
+});
+
+test("should drop cached styles of changed directories", () => {
+	const formatter = new ClangFormat().with_config("a", "BasedOnStyle: LLVM");
+	assert.equal(formatter.format(code, "a/main.cc"), code);
+
+	formatter.with_config("a", "BasedOnStyle: LLVM\nIndentWidth: 4");
+	assert.equal(formatter.format(code, "a/main.cc"), indented);
+
+	formatter.without_config("a");
+	assert.equal(formatter.format(code, "a/main.cc"), code);
+});
+
+test("should evaluate registered ignore files", () => {
+	const formatter = new ClangFormat()
+		.with_ignore("", "# generated\n*.gen.cc\nthird_party/**\n")
+		.with_ignore("src", "/src/legacy/*.cc\n");
+
+	const paths = ["main.cc", "main.gen.cc", "third_party/a/b.cc", "src/legacy/old.cc", "src/new.gen.cc"];
+	assert.deepEqual(formatter.filter_ignored(paths), ["main.cc", "src/new.gen.cc"]);
+	assert.equal(formatter.is_ignored("third_party/a/b.cc"), true);
+
+	const unformatted = "int  x;\n";
+	assert.equal(formatter.format(unformatted, "main.gen.cc"), unformatted);
+	assert.equal(formatter.format(unformatted, "main.cc"), "int x;\n");
+
+	formatter.without_ignore("");
+	assert.equal(formatter.is_ignored("third_party/a/b.cc"), false);
+});
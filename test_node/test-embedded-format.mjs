@@ -0,0 +1,37 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { format_embedded } from "../pkg/clang-format-node.js";
+
+const document = `# Example
+
+\`\`\`cpp
+int  main(){return 0;}
+\`\`\`
+
+- item
+
+  \`\`\`java
+  class A{int  x;}
+  \`\`\`
+
+\`\`\`text
+int  main(){return 0;}
+\`\`\`
+`;
+
+test("should format embedded code blocks", () => {
+	const actual = format_embedded(document);
+
+	assert.match(actual, /```cpp\nint main\(\) \{ return 0; \}\n```/);
+	assert.match(actual, /\n  ```java\n  class A \{[^`]*int x;[^`]*\}\n  ```\n/);
+	assert.match(actual, /```text\nint  main\(\)\{return 0;\}\n```/);
+});
+
+test("should keep formatted documents unchanged", () => {
+	const actual = format_embedded(document);
+	assert.equal(format_embedded(actual), actual);
+});
+
+test("should reject unknown document kinds", () => {
+	assert.throws(() => format_embedded(document, "rst"));
+});
@@ -5,7 +5,7 @@ import path from "node:path";
 import { test } from "node:test";
 import { fileURLToPath } from "node:url";
 
-import { format } from "../pkg/clang-format-node.js";
+import { ClangFormat, format } from "../pkg/clang-format-node.js";
 
 const test_root = fileURLToPath(import.meta.resolve("../test_data"));
 
@@ -25,3 +25,149 @@ for await (const case_name of glob("**/*.{c,cc,java,cs,js,ts,m,mm,proto}", { cwd
 		assert.equal(actual, expected);
 	});
 }
+
+for (const source of ["main.cc", "main.m"]) {
+	test(`${source} as a header`, async () => {
+		const full_path = path.join(test_root, source);
+		const [input, expected] = await Promise.all([readFile(full_path, "utf-8"), readFile(full_path + ".snap", "utf-8")]);
+
+		assert.equal(format(input, full_path.replace(/\.\w+$/, ".h")), expected);
+	});
+}
+
+test("message sends in headers", () => {
+	// Each language gets its own indentation, so the result shows the guess.
+	const style = "---\nLanguage: Cpp\nIndentWidth: 8\n---\nLanguage: ObjC\nIndentWidth: 2\n";
+	for (const send of ["[obj\n    doSomething]", "[x[0] foo]"]) {
+		const expected = `void f() {\n  ${send.replace(/\s+/, " ")};\n}\n`;
+		assert.equal(format(`void f() {\n${send};\n}\n`, "main.h", style), expected);
+	}
+	assert.equal(format("void f() {\nx[0] = y;\n}\n", "main.h", style), "void f() {\n        x[0] = y;\n}\n");
+	const hinted = "// clang-format Language: ObjC\nvoid f() {\nx[0] = y;\n}\n";
+	assert.equal(format(hinted, "main.h", style), "// clang-format Language: ObjC\nvoid f() {\n  x[0] = y;\n}\n");
+});
+
+test("large initializer list", () => {
+	const items = Array.from({ length: 3000 }, (_, i) => String((i * 7919) % 100003));
+	const actual = format(`int table[] = {${items.join(", ")}};\n`, "table.cc");
+
+	assert.ok(actual.split("\n").every((line) => line.length <= 80));
+	assert.deepEqual(actual.match(/\d+(?=[,}])/g), items);
+	assert.equal(format(actual, "table.cc"), actual);
+});
+
+test("large initializer lists match the line breaking search", () => {
+	// clang-format off anywhere in the input turns the list layout off.
+	const off = "// clang-format off\n";
+	const table = (declaration, items) => `${declaration} = {${items.join(", ")}};\n`;
+	const numbers = (count, base) => Array.from({ length: count }, (_, i) => String(base + ((i * 7919) % (9 * base))));
+
+	for (const code of [
+		table("int t[]", numbers(1000, 10000000)),
+		table("static const unsigned kRatherLongTableNameThatPushesTheBraceRight[]", numbers(1000, 10000)),
+		table("const int table[]", numbers(1100, 10000)),
+	]) {
+		assert.equal(format(code, "table.cc"), format(code + off, "table.cc").slice(0, -off.length));
+	}
+});
+
+test("comment blocks", () => {
+	const license = "// Copyright line one\n// Copyright line two\n//\n// Licensed under the terms below.\n";
+	const body = "void f() {\n// one\n// two\n// three\n// four\n  g();\n}\n";
+	const expected = "void f() {\n  // one\n  // two\n  // three\n  // four\n  g();\n}\n";
+
+	assert.equal(format(`\n${license}\n\n\n${body}`, "main.cc"), `${license}\n${expected}`);
+
+	const indented = "  // a\n  // b\n  // c\n  // d\nint x;\n";
+	const unindented = "// a\n// b\n// c\n// d\nint x;\n";
+	assert.equal(format(indented, "main.cc"), unindented);
+	assert.equal(format(`void f() {}\n${indented}`, "main.cc"), `void f() {}\n${unindented}`);
+});
+
+test("raw strings in another language", () => {
+	const literal = 'R"pb(key:   1   other :   "x")pb"';
+	const actual = format(`auto a = ${literal};\nauto b = ${literal};\n`, "main.cc", "Google");
+	const expected = 'R"pb(key: 1 other: "x")pb"';
+
+	assert.equal(actual, `auto a = ${expected};\nauto b = ${expected};\n`);
+	assert.equal(format(actual, "main.cc", "Google"), actual);
+});
+
+test("macros the code does not use", async () => {
+	const code = await readFile(path.join(test_root, "macros.cc"), "utf-8");
+	const used = ["FIELD(r, t, n)=r.field<t>(n)", "INDEX(r, i, c)=r.index(i, c)", "VALIDATOR(r, t, f)=CHECKED(r.validate<t>(f))", "CHECKED(x)=x"];
+	const unused = Array.from({ length: 200 }, (_, i) => `UNUSED_${i}(x)=x + ${i}`);
+	const style = (macros) => JSON.stringify({ BasedOnStyle: "LLVM", Macros: macros });
+
+	assert.equal(format(code, "macros.cc", style([...unused, ...used])), format(code, "macros.cc", style(used)));
+});
+
+test("large files in chunks", () => {
+	const functions = (body) => Array.from({ length: 6000 }, (_, i) => `int f${i}(int a)${body(i)}\n`).join("\n");
+	const actual = new ClangFormat().with_chunking().format(functions((i) => `{return a+${i};}  `), "large.cc");
+
+	assert.equal(actual, functions((i) => ` { return a + ${i}; }`));
+});
+
+test("chunking formats test_data like the whole files", async () => {
+	const chunked = new ClangFormat().with_chunking();
+
+	for await (const case_name of glob("**/*.{c,cc,mm}", { cwd: test_root })) {
+		const full_path = path.join(test_root, case_name);
+		const input = await readFile(full_path, "utf-8");
+		// Repeated up to the size formatted in chunks.
+		const code = Array.from({ length: Math.ceil((256 * 1024) / input.length) }, () => input).join("\n");
+
+		assert.equal(chunked.format(code, full_path), format(code, full_path), case_name);
+	}
+});
+
+test("include categories", () => {
+	const style = JSON.stringify({
+		BasedOnStyle: "LLVM",
+		IncludeBlocks: "Regroup",
+		IncludeCategories: [
+			{ Regex: '^"project/', Priority: 1 },
+			{ Regex: "^<[a-z_]+>$", Priority: 3 },
+			{ Regex: ".*", Priority: 2 },
+		],
+	});
+	const code = '#include <vector>\n#include "other/b.h"\n#include "project/a.h"\n';
+
+	assert.equal(format(code, "main.cc", style), '#include "project/a.h"\n\n#include "other/b.h"\n\n#include <vector>\n');
+});
+
+test("main header regex", () => {
+	const formatter = new ClangFormat().with_style(
+		JSON.stringify({ BasedOnStyle: "LLVM", IncludeBlocks: "Regroup", IncludeIsMainRegex: "(-impl)?$" }),
+	);
+	const code = '#include "bar.h"\n#include "foo.h"\n#include <vector>\n';
+	const expected = '#include "foo.h"\n\n#include "bar.h"\n\n#include <vector>\n';
+
+	// The second file reuses the regexes compiled for the first.
+	assert.equal(formatter.format(code, "foo-impl.cc"), expected);
+	assert.equal(formatter.format(code, "src/foo-impl.cc"), expected);
+	assert.equal(formatter.format(code, "foo-test.cc"), '#include "bar.h"\n#include "foo.h"\n\n#include <vector>\n');
+});
+
+test("nesting depth limit", () => {
+	const blocks = (depth) => `void f() ${"{ ".repeat(depth)}${"} ".repeat(depth)}\n`;
+
+	assert.match(format(blocks(512), "deep.cc"), /^void f\(\) \{\n {2}\{\n/);
+	assert.throws(() => format(blocks(513), "deep.cc"), {
+		message: "nesting depth 513 exceeds the supported maximum of 512",
+	});
+});
+
+test("nesting depth limit without brackets", () => {
+	const chain = (length) => `void f() {\nif (a) g();\n${"else if (a) g();\n".repeat(length)}}\n`;
+	const unbraced = (depth) => `void f() {\n${"if (a) ".repeat(depth)}g();\n}\n`;
+	const angles = (depth) => `A${"<A".repeat(depth)}${">".repeat(depth)} a;\n`;
+
+	assert.match(format(chain(509), "deep.cc"), / {2}else if \(a\)\n {4}g\(\);\n\}\n$/);
+	for (const code of [chain(510), unbraced(511), angles(513)]) {
+		assert.throws(() => format(code, "deep.cc"), {
+			message: "nesting depth 513 exceeds the supported maximum of 512",
+		});
+	}
+});
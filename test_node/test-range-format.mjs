@@ -1,6 +1,6 @@
 import assert from "node:assert/strict";
 import { test } from "node:test";
-import { format_byte_range, format_line_range } from "../pkg/clang-format-node.js";
+import { format, format_byte_range, format_changed, format_line_range } from "../pkg/clang-format-node.js";
 
 const part1 = `struct Foo { // 1
     int    x; // 2
@@ -43,3 +43,28 @@ test("should format byte range", () => {
 	assert.equal(slice1, part1);
 	assert.notEqual(slice2, part2);
 });
+
+test("should format only changed lines", () => {
+	const old_content = "int  a;\nint  b;\nint  c;\n";
+	const new_content = "int  a;\nint  b;\nint  x = 1  + 2;\n";
+
+	assert.equal(format_changed(old_content, new_content, "test.c"), "int  a;\nint  b;\nint x = 1 + 2;\n");
+	assert.equal(format_changed(new_content, new_content, "test.c"), new_content);
+	assert.equal(format_changed(old_content, "int  a;\nint  c;\n", "test.c"), "int  a;\nint  c;\n");
+});
+
+test("should format a line range of a large file like the whole file", () => {
+	const decl = (i) => `int  f${i}(int  a) {\n  return  a  +  ${i};\n}\n`;
+	const decls = Array.from({ length: 400 }, (_, i) => decl(i));
+	const content = `#ifndef TEST_H\n#define TEST_H\n\nnamespace  test {\n\n${decls.join("\n")}\n}\n\n#endif\n`;
+
+	// Lines of decl(200), after the 5 header lines and 4 lines per decl.
+	const from = 6 + 200 * 4;
+	const expected = content.replace(decl(200), format(decl(200), "test.cc"));
+
+	assert.equal(format_line_range(content, from, from + 2, "test.cc"), expected);
+	assert.equal(
+		format_line_range(content, 6, 8, "test.cc"),
+		content.replace(decl(0), format(decl(0), "test.cc")),
+	);
+});
@@ -0,0 +1,105 @@
+import assert from "node:assert/strict";
+import { test } from "node:test";
+import { ClangFormat, heap_stats } from "../pkg/clang-format-node.js";
+
+const code = "#include <b.h>\n#include <a.h>\nint  main(){return 0;}\n";
+
+test("should not collect stats by default", () => {
+	const formatter = new ClangFormat();
+	formatter.format(code, "main.cc");
+
+	assert.equal(formatter.last_stats().bytes, 0);
+});
+
+test("should report the work of the last call", () => {
+	const formatter = new ClangFormat().with_stats();
+	formatter.format(code, "main.cc");
+
+	const stats = formatter.last_stats();
+	assert.equal(stats.bytes, code.length);
+	assert.ok(stats.tokens > 0);
+	assert.ok(stats.replacements > stats.include_replacements);
+	assert.ok(stats.include_replacements > 0);
+	assert.equal(stats.styles_resolved, 1);
+	assert.ok(stats.reformat_ms >= 0);
+	assert.ok(stats.unwrapped_lines >= 3);
+
+	formatter.format(code, "main.cc");
+	assert.equal(formatter.last_stats().styles_resolved, 0);
+});
+
+test("should count the preprocessor branch passes", () => {
+	const formatter = new ClangFormat().with_stats();
+	formatter.format(code, "main.cc");
+	const plain = formatter.last_stats().parse_passes;
+	assert.ok(plain >= 1);
+
+	// Every analyzer parses the three branch combinations.
+	const nested = "#if A\n#if B\nb();\n#else\nc();\n#endif\n#else\nd();\n#endif\n";
+	formatter.format(`void f() {\n${nested.repeat(3)}}\n`, "main.cc");
+	assert.equal(formatter.last_stats().parse_passes, 3 * plain);
+});
+
+test("should count the states of the line breaking search", () => {
+	const formatter = new ClangFormat().with_stats();
+	formatter.format(code, "main.cc");
+	const short = formatter.last_stats().penalty_states;
+
+	const args = Array.from({ length: 20 }, (_, i) => `argument${i}`).join(", ");
+	formatter.format(`void f() { call(${args}); }\n`, "main.cc");
+	assert.ok(formatter.last_stats().penalty_states > short);
+});
+
+test("should record the stats of calls that return early", () => {
+	const formatter = new ClangFormat().with_stats();
+	formatter.format(code, "main.cc");
+	assert.ok(formatter.last_stats().bytes > 0);
+
+	assert.throws(() => formatter.format_line(code, 0, 1, "main.cc"));
+	assert.equal(formatter.last_stats().bytes, 0);
+
+	formatter.format(code, "main.cc");
+	formatter.format_changed(code, code, "main.cc");
+	assert.equal(formatter.last_stats().bytes, 0);
+});
+
+test("should sum the stats of a batch", () => {
+	const formatter = new ClangFormat().with_stats();
+	formatter.format_batch([
+		{ content: code, filename: "a.cc" },
+		{ content: code, filename: "b.cc" },
+	]);
+
+	assert.equal(formatter.last_stats().bytes, 2 * code.length);
+});
+
+test("should account heap usage", () => {
+	const before = heap_stats();
+	const formatter = new ClangFormat().with_stats();
+	formatter.format(code, "main.cc");
+	const after = heap_stats();
+
+	const stats = formatter.last_stats();
+	assert.ok(stats.heap_allocations > 0);
+	assert.ok(stats.heap_peak_bytes > 0);
+	assert.ok(after.allocated_bytes - before.allocated_bytes >= stats.heap_allocated_bytes);
+	assert.ok(Number.isInteger(stats.heap_allocated_bytes));
+	assert.ok(Number.isInteger(stats.heap_peak_bytes));
+	assert.ok(after.peak_bytes >= after.current_bytes);
+	assert.ok(after.memory_bytes >= after.peak_bytes);
+});
+
+test("should report the most expensive lines", () => {
+	const lines = Array.from({ length: 50 }, (_, i) => `int f${i}(){return ${i};}`);
+	lines[20] = `int table[] = {${Array.from({ length: 2000 }, (_, i) => i).join(",")}};`;
+
+	// Times vary between runs, the explored states do not.
+	const report = new ClangFormat().profile_lines(lines.join("\n"), "main.cc", 3);
+	const rows = report
+		.trim()
+		.split("\n")
+		.map((row) => row.match(/^\s*([\d.]+) ms\s+(\d+) states  line (\d+)/));
+	assert.ok(rows.length > 0 && rows.every(Boolean));
+	const most = rows.reduce((a, b) => (Number(b[2]) > Number(a[2]) ? b : a));
+	assert.equal(most[3], "21");
+});